@@ -8,8 +8,15 @@ in VS_OUT {
     vec3 Normal;
 } fs_in;
 
+layout (std140) uniform FrameUniforms
+{
+    mat4 projection;
+    mat4 view;
+    vec4 viewPos;
+    float time;
+};
+
 uniform vec3 lightPos;
-uniform vec3 viewPos;
 uniform vec3 lightColor;
 
 uniform sampler2D diffuseTexture;
@@ -32,7 +39,7 @@ void main()
 
     // specular
     float specularStrength = 0.2;
-    vec3 viewDir = normalize(viewPos - fs_in.FragPos);
+    vec3 viewDir = normalize(viewPos.xyz - fs_in.FragPos);
     vec3 reflectDir = reflect(-lightDir, norm);
     float spec = pow(max(dot(viewDir, reflectDir), 0.0), 32);
     vec3 specular = specularStrength * spec * lightColor;
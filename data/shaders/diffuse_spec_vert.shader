@@ -14,8 +14,14 @@ out VS_OUT {
     vec3 Normal;
 } vs_out;
 
-uniform mat4 projection;
-uniform mat4 view;
+layout (std140) uniform FrameUniforms
+{
+    mat4 projection;
+    mat4 view;
+    vec4 viewPos;
+    float time;
+};
+
 uniform mat4 model;
 
 void main()
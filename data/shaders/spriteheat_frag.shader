@@ -5,7 +5,13 @@ in VS_OUT {
     vec2 TexCoords;
 } fs_in;
 
-uniform float time;
+layout (std140) uniform FrameUniforms
+{
+    mat4 projection;
+    mat4 view;
+    vec4 viewPos;
+    float time;
+};
 
 uniform sampler2D diffuseTexture;
 
@@ -9,10 +9,15 @@ out VS_OUT {
     vec2 TexCoords;
 } vs_out;
 
-uniform mat4  projection;
-uniform mat4  view;
+layout (std140) uniform FrameUniforms
+{
+    mat4 projection;
+    mat4 view;
+    vec4 viewPos;
+    float time;
+};
+
 uniform mat4  model;
-uniform float time;
 
 void main()
 {
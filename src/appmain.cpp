@@ -318,8 +318,8 @@ bool CAppMain::GenerateLightmaps(CLightmapGen::lmoptions_t lampOptions, std::vec
 
 bool CAppMain::OnUIMeshLoad(const std::string& filename)
 {
-    MeshFile tmpMesh;
-    if (!tmpMesh.LoadFromFile(filename))
+    MeshFileView tmpMesh;
+    if (!tmpMesh.Open(filename))
     {
         Log("Cant find mesh %s\n", filename.c_str());
         return false;
@@ -350,11 +350,11 @@ bool CAppMain::OnUIMeshLoad(const std::string& filename)
 
     DeleteLights();
 
-    std::vector<mesh::SLight>& meshLights = tmpMesh.GetLightsRef();
-    for (auto& light : meshLights)
+    for (uint32_t i = 0; i < tmpMesh.GetLightCount(); i++)
     {
+        const mesh::SLight& light = tmpMesh.GetLights()[i];
         Light newLight{};
-        newLight.name = std::string(light.name);
+        newLight.name = std::string(light.name, strnlen(light.name, mesh::MATERIAL_NAME_LEN));
         newLight.pos = rade::vector3(light.pos);
         newLight.orientation = rade::vector3(light.dir);
         newLight.brightness = light.brightness;
@@ -390,7 +390,8 @@ bool CAppMain::OnUIMeshSave(const std::string& filename)
     for (CLightmapImg* lm : m_lightMapList)
     {
         // add these in the same order as generated so indexes match up
-        outputMeshFile.AddLightmapData(lm->m_width, lm->m_height, lm->m_data, lm->m_width * lm->m_height * 4);
+        outputMeshFile.AddLightmapData(lm->m_width, lm->m_height, lm->m_data, lm->m_width * lm->m_height * 4,
+                static_cast<rade::ELightmapEncoding>(lm->m_encoding));
     }
 
     for (auto& light : m_lights)
@@ -0,0 +1,264 @@
+// headless lightmap baker, bakes an rbmesh with the lights stored in it and writes the result
+// without a window or GL context
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "blur.h"
+#include "lightmapgen.h"
+#include "meshfile.h"
+#include "osutils.h"
+#include "sampler.h"
+#include "timer.h"
+
+namespace
+{
+    void PrintUsage()
+    {
+        printf("usage: radegen_baker <input.rbmesh> <output.rbmesh> [options]\n"
+               "  --rays <n>              AO sphere rays per lumel\n"
+               "  --sphere-size <f>       AO sphere size\n"
+               "  --lit <n>               lit intensity\n"
+               "  --unlit <n>             unlit intensity\n"
+               "  --detail <f>            lightmap resolution (lumels per unit)\n"
+               "  --blur <n>              post blur passes\n"
+               "  --blur-radius <n>       post blur taps either side, 1-8\n"
+               "  --blur-kernel <k>       box or gaussian\n"
+               "  --blur-mask             only blur lumels on the poly\n"
+               "  --ao / --no-ao          ambient occlusion\n"
+               "  --shadows / --no-shadows\n"
+               "  --sun / --no-sun\n"
+               "  --sun-colour <r,g,b>    0-1 range\n"
+               "  --sun-dir <x,y,z>\n"
+               "  --no-bvh                brute force occlusion tests (for validation)\n"
+               "  --no-packets            trace AO and sun rays one at a time\n"
+               "  --packet-report         after the bake, log AO rays/sec single vs packets\n"
+               "  --threads <n>           worker threads, 0 = one per hardware thread\n"
+               "  --seed <n>              seed for the AO ray sets\n"
+               "  --sampling <mode>       random, stratified or hammersley\n"
+               "  --atlas <n>             atlas page size, 0 = one lightmap per poly\n"
+               "  --compression-level <n> deflate level for the stored lightmaps, 0-10\n"
+               "  --hdr                   keep light above white, lightmaps are stored RGBM\n"
+               "  --lightmap-format <f>   lossless or bc1\n"
+               "  --bc1-quality <q>       fast, normal or high\n");
+    }
+
+    bool ParseFloat3(const char* str, float* out)
+    {
+        return sscanf(str, "%f,%f,%f", &out[0], &out[1], &out[2]) == 3;
+    }
+
+    typedef struct
+    {
+        int compressionLevel;
+        rade::ELightmapStorage storage;
+        rade::EBC1Quality bc1Quality;
+    } storageoptions_t;
+
+    bool ParseOptions(int argc, char** argv, CLightmapGen::lmoptions_t& options, storageoptions_t& storage)
+    {
+        for (int i = 3; i < argc; i++)
+        {
+            std::string arg = argv[i];
+            bool hasValue = i + 1 < argc;
+            const char* value = hasValue ? argv[i + 1] : "";
+
+            if (arg == "--ao") options.createAO = true;
+            else if (arg == "--no-ao") options.createAO = false;
+            else if (arg == "--shadows") options.createShadows = true;
+            else if (arg == "--no-shadows") options.createShadows = false;
+            else if (arg == "--sun") options.createSun = true;
+            else if (arg == "--no-sun") options.createSun = false;
+            else if (arg == "--no-bvh") options.useBVH = false;
+            else if (arg == "--no-packets") options.usePackets = false;
+            else if (arg == "--packet-report") options.reportPacketGain = true;
+            else if (arg == "--hdr") options.hdr = true;
+            else if (arg == "--blur-mask") options.blurMask = true;
+            else if (!hasValue)
+            {
+                rade::Log("Missing value for %s\n", arg.c_str());
+                return false;
+            }
+            else
+            {
+                i++;
+                if (arg == "--rays") options.numSphereRays = atoi(value);
+                else if (arg == "--sphere-size") options.sphereSize = static_cast<float>(atof(value));
+                else if (arg == "--lit") options.shadowLit = atoi(value);
+                else if (arg == "--unlit") options.shadowUnlit = atoi(value);
+                else if (arg == "--detail") options.lmDetail = static_cast<float>(atof(value));
+                else if (arg == "--blur") options.postBlur = atoi(value);
+                else if (arg == "--blur-radius") options.blurRadius = atoi(value);
+                else if (arg == "--threads") options.numThreads = atoi(value);
+                else if (arg == "--seed") options.seed = atoi(value);
+                else if (arg == "--atlas") options.atlasSize = atoi(value);
+                else if (arg == "--compression-level") storage.compressionLevel = atoi(value);
+                else if (arg == "--sun-colour" || arg == "--sun-dir")
+                {
+                    float* target = arg == "--sun-dir" ? options.sunDir : options.sunColour;
+                    if (!ParseFloat3(value, target))
+                    {
+                        rade::Log("Expected x,y,z for %s\n", arg.c_str());
+                        return false;
+                    }
+                }
+                else if (arg == "--sampling")
+                {
+                    std::string mode = value;
+                    if (mode == "random") options.samplingMode = rade::sampling::ESampleMode_Random;
+                    else if (mode == "stratified") options.samplingMode = rade::sampling::ESampleMode_Stratified;
+                    else if (mode == "hammersley") options.samplingMode = rade::sampling::ESampleMode_Hammersley;
+                    else
+                    {
+                        rade::Log("Unknown sampling mode %s\n", value);
+                        return false;
+                    }
+                }
+                else if (arg == "--blur-kernel")
+                {
+                    std::string kernel = value;
+                    if (kernel == "box") options.blurKernel = rade::blur::EKernel_Box;
+                    else if (kernel == "gaussian") options.blurKernel = rade::blur::EKernel_Gaussian;
+                    else
+                    {
+                        rade::Log("Unknown blur kernel %s\n", value);
+                        return false;
+                    }
+                }
+                else if (arg == "--lightmap-format")
+                {
+                    std::string format = value;
+                    if (format == "lossless") storage.storage = rade::ELightmapStorage_Lossless;
+                    else if (format == "bc1") storage.storage = rade::ELightmapStorage_BC1;
+                    else
+                    {
+                        rade::Log("Unknown lightmap format %s\n", value);
+                        return false;
+                    }
+                }
+                else if (arg == "--bc1-quality")
+                {
+                    std::string quality = value;
+                    if (quality == "fast") storage.bc1Quality = rade::EBC1Quality_Fast;
+                    else if (quality == "normal") storage.bc1Quality = rade::EBC1Quality_Normal;
+                    else if (quality == "high") storage.bc1Quality = rade::EBC1Quality_High;
+                    else
+                    {
+                        rade::Log("Unknown BC1 quality %s\n", value);
+                        return false;
+                    }
+                }
+                else
+                {
+                    rade::Log("Unknown option %s\n", arg.c_str());
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    rade::UtilsInit();
+
+    if (argc < 3)
+    {
+        PrintUsage();
+        return 1;
+    }
+
+    std::string inFile = argv[1];
+    std::string outFile = argv[2];
+
+    CLightmapGen lmGen;
+    CLightmapGen::lmoptions_t options = lmGen.GetOptions();
+    storageoptions_t storage = { rade::cDefaultLightmapCompressionLevel, rade::ELightmapStorage_Lossless,
+                                 rade::EBC1Quality_Normal };
+    if (!ParseOptions(argc, argv, options, storage))
+    {
+        PrintUsage();
+        return 1;
+    }
+
+    rade::MeshFileView inputMesh;
+    if (!inputMesh.Open(inFile))
+    {
+        rade::Log("Cant find mesh %s\n", inFile.c_str());
+        return 1;
+    }
+
+    std::vector<rade::poly3d> polyList;
+    inputMesh.GetAsPolyList(polyList);
+
+    std::vector<rade::Light> lights;
+    for (uint32_t i = 0; i < inputMesh.GetLightCount(); i++)
+    {
+        const rade::mesh::SLight& light = inputMesh.GetLights()[i];
+        rade::Light newLight{};
+        newLight.name = std::string(light.name, strnlen(light.name, rade::mesh::MATERIAL_NAME_LEN));
+        newLight.pos = rade::vector3(light.pos);
+        newLight.orientation = rade::vector3(light.dir);
+        newLight.brightness = light.brightness;
+        newLight.radius = light.radius;
+        for (int axis = 0; axis < 3; axis++)
+            newLight.color[axis] = light.color[axis];
+        lights.push_back(newLight);
+    }
+
+    // the generator works in 0-255 colours, the mesh and options store 0-1 (as CAppMain::GenerateLightmaps)
+    std::vector<rade::Light> bakeLights = lights;
+    for (auto& light : bakeLights)
+    {
+        for (float& c : light.color)
+            c = std::min<float>(c * 255, 255);
+    }
+    for (float& c : options.sunColour)
+        c = std::min<float>(c * 255, 255);
+
+    rade::Log("baking %s, %u polys, %u lights\n", inFile.c_str(),
+            static_cast<unsigned int>(polyList.size()), static_cast<unsigned int>(lights.size()));
+
+    int lastPct = -1;
+    lmGen.RegisterCallback(
+            [&lastPct](int pctComplete)
+            {
+                if (pctComplete / 10 != lastPct / 10)
+                    rade::Log("%d%%\n", pctComplete);
+                lastPct = pctComplete;
+            });
+
+    rade::timer timer;
+    std::vector<CLightmapImg*> lightMapList;
+    lmGen.Generate(options, polyList, bakeLights, &lightMapList);
+    rade::Log("lightmap generation took %.2f seconds\n", timer.ElapsedTime());
+
+    rade::MeshFile outputMesh(polyList);
+    outputMesh.SetCompressionLevel(storage.compressionLevel);
+    outputMesh.SetLightmapStorage(storage.storage, storage.bc1Quality);
+    for (CLightmapImg* lm : lightMapList)
+    {
+        // add these in the same order as generated so indexes match up
+        outputMesh.AddLightmapData(lm->m_width, lm->m_height, lm->m_data, lm->m_width * lm->m_height * 4,
+                static_cast<rade::ELightmapEncoding>(lm->m_encoding));
+    }
+    for (auto& light : lights)
+        outputMesh.AddLight(light);
+
+    bool written = outputMesh.WriteToFile(outFile);
+
+    for (CLightmapImg* lm : lightMapList)
+        delete lm;
+
+    if (!written)
+    {
+        rade::Log("Failed to save %s\n", outFile.c_str());
+        return 1;
+    }
+    rade::Log("wrote %s\n", outFile.c_str());
+    return 0;
+}
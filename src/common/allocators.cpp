@@ -0,0 +1,160 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include "allocators.h"
+
+namespace rade
+{
+    namespace
+    {
+        // scratch arena chunk, bigger requests get a chunk of their own size
+        const size_t cChunkSize = 1024 * 1024;
+
+        // block pool size classes
+        const size_t cMinBlockSize = 4096;
+        const size_t cMaxBlockSize = 256 * 1024 * 1024;
+    }
+
+    ScratchArena::~ScratchArena()
+    {
+        for (chunk_t& chunk : m_chunks)
+            free(chunk.data);
+    }
+
+    ScratchArena& ScratchArena::ForThread()
+    {
+        thread_local ScratchArena arena;
+        return arena;
+    }
+
+    void* ScratchArena::Allocate(size_t size, size_t align)
+    {
+        while (m_chunk < m_chunks.size())
+        {
+            chunk_t& chunk = m_chunks[m_chunk];
+            auto base = reinterpret_cast<uintptr_t>(chunk.data);
+            size_t offset = ((base + m_offset + align - 1) & ~(uintptr_t)(align - 1)) - base;
+            if (offset + size <= chunk.size)
+            {
+                m_offset = offset + size;
+                return chunk.data + offset;
+            }
+
+            // on to the next chunk, a kept one too small for this request is dropped
+            m_chunk++;
+            m_offset = 0;
+            if (m_chunk < m_chunks.size() && m_chunks[m_chunk].size < size + align)
+            {
+                free(m_chunks[m_chunk].data);
+                m_chunks.erase(m_chunks.begin() + m_chunk);
+            }
+        }
+
+        chunk_t chunk;
+        chunk.size = std::max(cChunkSize, size + align);
+        chunk.data = static_cast<unsigned char*>(malloc(chunk.size));
+        m_chunks.push_back(chunk);
+        m_chunk = m_chunks.size() - 1;
+        m_offset = 0;
+        return Allocate(size, align);
+    }
+
+    void ScratchArena::Rewind(const marker_t& marker)
+    {
+        m_chunk = marker.chunk;
+        m_offset = marker.offset;
+    }
+
+    BlockPool::BlockPool()
+    {
+        // each class a quarter bigger than the last, in whole pages
+        std::vector<size_t> sizes;
+        for (size_t size = cMinBlockSize; size < cMaxBlockSize; )
+        {
+            sizes.push_back(size);
+            size_t next = size + std::max(size / 4, cMinBlockSize);
+            size = (next + cMinBlockSize - 1) / cMinBlockSize * cMinBlockSize;
+        }
+        sizes.push_back(cMaxBlockSize);
+
+        m_numClasses = sizes.size();
+        m_classes.reset(new sizeclass_t[m_numClasses]);
+        for (size_t i = 0; i < m_numClasses; i++)
+            m_classes[i].blockSize = sizes[i];
+    }
+
+    BlockPool::~BlockPool()
+    {
+        Trim();
+    }
+
+    BlockPool& BlockPool::Get()
+    {
+        static BlockPool pool;
+        return pool;
+    }
+
+    void* BlockPool::Allocate(size_t size)
+    {
+        sizeclass_t* sizeClass = GetSizeClass(size);
+        if (!sizeClass)
+            return malloc(size);
+
+        {
+            std::lock_guard<std::mutex> lock(sizeClass->mutex);
+            if (!sizeClass->freeBlocks.empty())
+            {
+                void* block = sizeClass->freeBlocks.back();
+                sizeClass->freeBlocks.pop_back();
+                return block;
+            }
+        }
+        return malloc(sizeClass->blockSize);
+    }
+
+    void BlockPool::Free(void* ptr, size_t size)
+    {
+        if (!ptr)
+            return;
+
+        sizeclass_t* sizeClass = GetSizeClass(size);
+        if (!sizeClass)
+        {
+            free(ptr);
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock(sizeClass->mutex);
+        sizeClass->freeBlocks.push_back(ptr);
+    }
+
+    void BlockPool::Trim()
+    {
+        for (size_t i = 0; i < m_numClasses; i++)
+        {
+            std::lock_guard<std::mutex> lock(m_classes[i].mutex);
+            for (void* block : m_classes[i].freeBlocks)
+                free(block);
+            m_classes[i].freeBlocks.clear();
+        }
+    }
+
+    BlockPool::sizeclass_t* BlockPool::GetSizeClass(size_t size)
+    {
+        // small long lived buffers (1x1 and per poly lightmaps) would waste most of a block
+        if (size < cMinBlockSize || size > cMaxBlockSize)
+            return nullptr;
+
+        size_t first = 0;
+        size_t last = m_numClasses - 1;
+        while (first < last)
+        {
+            size_t mid = (first + last) / 2;
+            if (m_classes[mid].blockSize < size)
+                first = mid + 1;
+            else
+                last = mid;
+        }
+        return &m_classes[first];
+    }
+};
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace rade
+{
+    // bump allocator for short lived scratch memory. Every thread has its own (ForThread()) so
+    // there is no locking, memory goes back with a ScratchScope and the chunks are kept for the
+    // next user
+    class ScratchArena
+    {
+    public:
+
+        typedef struct
+        {
+            size_t chunk;
+            size_t offset;
+        } marker_t;
+
+        ScratchArena() = default;
+
+        ~ScratchArena();
+
+        ScratchArena(const ScratchArena&) = delete;
+        ScratchArena& operator=(const ScratchArena&) = delete;
+
+        static ScratchArena& ForThread();
+
+        void* Allocate(size_t size, size_t align = 16);
+
+        template<typename T>
+        T* AllocateArray(size_t count)
+        {
+            return static_cast<T*>(Allocate(count * sizeof(T), alignof(T) > 16 ? alignof(T) : 16));
+        }
+
+        marker_t GetMarker() const
+        {
+            return { m_chunk, m_offset };
+        }
+
+        // frees everything allocated since the marker was taken
+        void Rewind(const marker_t& marker);
+
+    private:
+
+        typedef struct
+        {
+            unsigned char* data;
+            size_t size;
+        } chunk_t;
+
+        std::vector<chunk_t> m_chunks;
+        size_t m_chunk = 0;
+        size_t m_offset = 0;
+    };
+
+    // rewinds the arena to where it was when the scope opened
+    class ScratchScope
+    {
+    public:
+
+        explicit ScratchScope(ScratchArena& arena)
+                : m_arena(arena), m_marker(arena.GetMarker())
+        {
+        }
+
+        ~ScratchScope()
+        {
+            m_arena.Rewind(m_marker);
+        }
+
+        ScratchScope(const ScratchScope&) = delete;
+        ScratchScope& operator=(const ScratchScope&) = delete;
+
+    private:
+        ScratchArena& m_arena;
+        ScratchArena::marker_t m_marker;
+    };
+
+    // process wide pool of large blocks, for lightmap and lumel buffers that are allocated and
+    // freed over and over through a bake. Sizes are rounded up to a size class (at most a
+    // quarter over) and freed blocks wait on that class's list for the next allocation instead
+    // of going back to the system. Anything under a page is not pooled
+    class BlockPool
+    {
+    public:
+
+        static BlockPool& Get();
+
+        ~BlockPool();
+
+        BlockPool(const BlockPool&) = delete;
+        BlockPool& operator=(const BlockPool&) = delete;
+
+        void* Allocate(size_t size);
+
+        // size must be the size given to Allocate()
+        void Free(void* ptr, size_t size);
+
+        // hand every block on the free lists back to the system
+        void Trim();
+
+    private:
+
+        typedef struct
+        {
+            size_t blockSize;
+            std::mutex mutex;
+            std::vector<void*> freeBlocks;
+        } sizeclass_t;
+
+        BlockPool();
+
+        // nullptr for sizes under a page or above the largest class, those go straight to malloc
+        sizeclass_t* GetSizeClass(size_t size);
+
+        std::unique_ptr<sizeclass_t[]> m_classes;
+        size_t m_numClasses = 0;
+    };
+};
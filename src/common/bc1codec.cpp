@@ -0,0 +1,347 @@
+#include <algorithm>
+#include <cmath>
+#include "bc1codec.h"
+
+namespace rade
+{
+    namespace
+    {
+        typedef struct
+        {
+            float c[16][3];
+        } colourblock_t;
+
+        uint16_t To565(const float* c)
+        {
+            auto r = static_cast<int>(std::min(std::max(c[0], 0.0f), 255.0f) * 31.0f / 255.0f + 0.5f);
+            auto g = static_cast<int>(std::min(std::max(c[1], 0.0f), 255.0f) * 63.0f / 255.0f + 0.5f);
+            auto b = static_cast<int>(std::min(std::max(c[2], 0.0f), 255.0f) * 31.0f / 255.0f + 0.5f);
+            return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+        }
+
+        void From565(uint16_t v, int* out)
+        {
+            int r = (v >> 11) & 31;
+            int g = (v >> 5) & 63;
+            int b = v & 31;
+            out[0] = (r << 3) | (r >> 2);
+            out[1] = (g << 2) | (g >> 4);
+            out[2] = (b << 3) | (b >> 2);
+        }
+
+        // the four colours a block can pick from, the three colour mode (c0 <= c1) ends in black
+        void BuildPalette(uint16_t c0, uint16_t c1, int palette[4][3])
+        {
+            From565(c0, palette[0]);
+            From565(c1, palette[1]);
+            for (int i = 0; i < 3; i++)
+            {
+                if (c0 > c1)
+                {
+                    palette[2][i] = (2 * palette[0][i] + palette[1][i] + 1) / 3;
+                    palette[3][i] = (palette[0][i] + 2 * palette[1][i] + 1) / 3;
+                }
+                else
+                {
+                    palette[2][i] = (palette[0][i] + palette[1][i]) / 2;
+                    palette[3][i] = 0;
+                }
+            }
+        }
+
+        // nearest palette entry for every lumel, returns the summed squared error
+        float PickIndices(const colourblock_t& block, uint16_t c0, uint16_t c1, uint32_t* outIndices)
+        {
+            int palette[4][3];
+            BuildPalette(c0, c1, palette);
+
+            uint32_t indices = 0;
+            float error = 0.0f;
+            for (int i = 0; i < 16; i++)
+            {
+                int best = 0;
+                float bestDist = 0.0f;
+                for (int p = 0; p < 4; p++)
+                {
+                    float dr = block.c[i][0] - palette[p][0];
+                    float dg = block.c[i][1] - palette[p][1];
+                    float db = block.c[i][2] - palette[p][2];
+                    float dist = dr * dr + dg * dg + db * db;
+                    if (p == 0 || dist < bestDist)
+                    {
+                        best = p;
+                        bestDist = dist;
+                    }
+                }
+                indices |= static_cast<uint32_t>(best) << (i * 2);
+                error += bestDist;
+            }
+            *outIndices = indices;
+            return error;
+        }
+
+        // quantizes both endpoints and keeps the four colour ordering (c0 > c1)
+        float EncodeEndpoints(const colourblock_t& block, const float* e0, const float* e1,
+                uint16_t* outC0, uint16_t* outC1, uint32_t* outIndices)
+        {
+            uint16_t c0 = To565(e0);
+            uint16_t c1 = To565(e1);
+            if (c0 < c1)
+                std::swap(c0, c1);
+
+            *outC0 = c0;
+            *outC1 = c1;
+            if (c0 == c1)
+            {
+                // a flat block, every lumel takes c0
+                *outIndices = 0;
+                int colour[3];
+                From565(c0, colour);
+                float error = 0.0f;
+                for (const float* c : block.c)
+                {
+                    for (int i = 0; i < 3; i++)
+                        error += (c[i] - colour[i]) * (c[i] - colour[i]);
+                }
+                return error;
+            }
+            return PickIndices(block, c0, c1, outIndices);
+        }
+
+        void BoundingBoxEndpoints(const colourblock_t& block, float* e0, float* e1)
+        {
+            for (int i = 0; i < 3; i++)
+            {
+                float minC = block.c[0][i];
+                float maxC = block.c[0][i];
+                for (const float* c : block.c)
+                {
+                    minC = std::min(minC, c[i]);
+                    maxC = std::max(maxC, c[i]);
+                }
+
+                // pull the ends in a little, the extremes are rarely worth a palette entry
+                float inset = (maxC - minC) / 16.0f;
+                e0[i] = maxC - inset;
+                e1[i] = minC + inset;
+            }
+        }
+
+        void PrincipalAxisEndpoints(const colourblock_t& block, float* e0, float* e1)
+        {
+            float mean[3] = {};
+            for (const float* c : block.c)
+            {
+                for (int i = 0; i < 3; i++)
+                    mean[i] += c[i] / 16.0f;
+            }
+
+            float cov[6] = {};
+            for (const float* c : block.c)
+            {
+                float r = c[0] - mean[0];
+                float g = c[1] - mean[1];
+                float b = c[2] - mean[2];
+                cov[0] += r * r;
+                cov[1] += r * g;
+                cov[2] += r * b;
+                cov[3] += g * g;
+                cov[4] += g * b;
+                cov[5] += b * b;
+            }
+
+            // power iteration for the dominant eigenvector, starting on the luminance axis
+            float axis[3] = { 0.299f, 0.587f, 0.114f };
+            for (int iter = 0; iter < 8; iter++)
+            {
+                float x = cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2];
+                float y = cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2];
+                float z = cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2];
+                float length = sqrtf(x * x + y * y + z * z);
+                if (length < 1e-6f)
+                    break;
+                axis[0] = x / length;
+                axis[1] = y / length;
+                axis[2] = z / length;
+            }
+
+            float minProj = 0.0f;
+            float maxProj = 0.0f;
+            for (const float* c : block.c)
+            {
+                float proj = (c[0] - mean[0]) * axis[0] + (c[1] - mean[1]) * axis[1] + (c[2] - mean[2]) * axis[2];
+                minProj = std::min(minProj, proj);
+                maxProj = std::max(maxProj, proj);
+            }
+
+            for (int i = 0; i < 3; i++)
+            {
+                e0[i] = mean[i] + axis[i] * maxProj;
+                e1[i] = mean[i] + axis[i] * minProj;
+            }
+        }
+
+        // least squares endpoints for a fixed set of indices, false if the indices all land on
+        // one endpoint
+        bool RefineEndpoints(const colourblock_t& block, uint32_t indices, float* e0, float* e1)
+        {
+            // weight of c0 for each four colour mode index
+            const float cWeights[4] = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+
+            float aa = 0.0f;
+            float bb = 0.0f;
+            float ab = 0.0f;
+            float ax[3] = {};
+            float bx[3] = {};
+            for (int i = 0; i < 16; i++)
+            {
+                float a = cWeights[(indices >> (i * 2)) & 3];
+                float b = 1.0f - a;
+                aa += a * a;
+                bb += b * b;
+                ab += a * b;
+                for (int c = 0; c < 3; c++)
+                {
+                    ax[c] += a * block.c[i][c];
+                    bx[c] += b * block.c[i][c];
+                }
+            }
+
+            float det = aa * bb - ab * ab;
+            if (fabsf(det) < 1e-6f)
+                return false;
+
+            for (int c = 0; c < 3; c++)
+            {
+                e0[c] = (ax[c] * bb - bx[c] * ab) / det;
+                e1[c] = (bx[c] * aa - ax[c] * ab) / det;
+            }
+            return true;
+        }
+
+        void EncodeBlock(const colourblock_t& block, EBC1Quality quality, unsigned char* out)
+        {
+            float e0[3];
+            float e1[3];
+            if (quality == EBC1Quality_Fast)
+                BoundingBoxEndpoints(block, e0, e1);
+            else
+                PrincipalAxisEndpoints(block, e0, e1);
+
+            uint16_t c0;
+            uint16_t c1;
+            uint32_t indices;
+            float error = EncodeEndpoints(block, e0, e1, &c0, &c1, &indices);
+
+            if (quality == EBC1Quality_High)
+            {
+                for (int iter = 0; iter < 2 && error > 0.0f; iter++)
+                {
+                    if (c0 == c1 || !RefineEndpoints(block, indices, e0, e1))
+                        break;
+
+                    uint16_t newC0;
+                    uint16_t newC1;
+                    uint32_t newIndices;
+                    float newError = EncodeEndpoints(block, e0, e1, &newC0, &newC1, &newIndices);
+                    if (newError >= error)
+                        break;
+                    c0 = newC0;
+                    c1 = newC1;
+                    indices = newIndices;
+                    error = newError;
+                }
+            }
+
+            out[0] = static_cast<unsigned char>(c0 & 0xFF);
+            out[1] = static_cast<unsigned char>(c0 >> 8);
+            out[2] = static_cast<unsigned char>(c1 & 0xFF);
+            out[3] = static_cast<unsigned char>(c1 >> 8);
+            for (int i = 0; i < 4; i++)
+                out[4 + i] = static_cast<unsigned char>(indices >> (i * 8));
+        }
+    }
+
+    size_t GetBC1Size(uint16_t width, uint16_t height)
+    {
+        return static_cast<size_t>((width + 3) / 4) * ((height + 3) / 4) * cBC1BlockSize;
+    }
+
+    void EncodeBC1(const unsigned char* rgba, uint16_t width, uint16_t height, EBC1Quality quality,
+            unsigned char* blocks)
+    {
+        unsigned char* out = blocks;
+        for (int by = 0; by < height; by += 4)
+        {
+            for (int bx = 0; bx < width; bx += 4)
+            {
+                colourblock_t block;
+                for (int i = 0; i < 16; i++)
+                {
+                    int x = std::min(bx + (i & 3), width - 1);
+                    int y = std::min(by + (i >> 2), height - 1);
+                    const unsigned char* lumel = rgba + (static_cast<size_t>(y) * width + x) * 4;
+                    block.c[i][0] = lumel[0];
+                    block.c[i][1] = lumel[1];
+                    block.c[i][2] = lumel[2];
+                }
+                EncodeBlock(block, quality, out);
+                out += cBC1BlockSize;
+            }
+        }
+    }
+
+    void DecodeBC1(const unsigned char* blocks, uint16_t width, uint16_t height, unsigned char* rgba)
+    {
+        const unsigned char* in = blocks;
+        for (int by = 0; by < height; by += 4)
+        {
+            for (int bx = 0; bx < width; bx += 4)
+            {
+                auto c0 = static_cast<uint16_t>(in[0] | (in[1] << 8));
+                auto c1 = static_cast<uint16_t>(in[2] | (in[3] << 8));
+                uint32_t indices = in[4] | (in[5] << 8) | (in[6] << 16) | (static_cast<uint32_t>(in[7]) << 24);
+                int palette[4][3];
+                BuildPalette(c0, c1, palette);
+
+                for (int i = 0; i < 16; i++)
+                {
+                    int x = bx + (i & 3);
+                    int y = by + (i >> 2);
+                    if (x >= width || y >= height)
+                        continue;
+
+                    const int* colour = palette[(indices >> (i * 2)) & 3];
+                    unsigned char* lumel = rgba + (static_cast<size_t>(y) * width + x) * 4;
+                    lumel[0] = static_cast<unsigned char>(colour[0]);
+                    lumel[1] = static_cast<unsigned char>(colour[1]);
+                    lumel[2] = static_cast<unsigned char>(colour[2]);
+                    lumel[3] = 255;
+                }
+                in += cBC1BlockSize;
+            }
+        }
+    }
+
+    uint64_t GetSquaredError(const unsigned char* rgbaA, const unsigned char* rgbaB, size_t numLumels)
+    {
+        uint64_t error = 0;
+        for (size_t i = 0; i < numLumels; i++)
+        {
+            for (int c = 0; c < 3; c++)
+            {
+                int d = rgbaA[i * 4 + c] - rgbaB[i * 4 + c];
+                error += static_cast<uint64_t>(d * d);
+            }
+        }
+        return error;
+    }
+
+    double GetPSNR(uint64_t squaredError, size_t numSamples)
+    {
+        if (squaredError == 0 || numSamples == 0)
+            return 99.0;
+        double mse = static_cast<double>(squaredError) / static_cast<double>(numSamples);
+        return 10.0 * log10(255.0 * 255.0 / mse);
+    }
+};
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace rade
+{
+    // BC1 (DXT1) blocks, 8 bytes for every 4x4 lumels, uploaded as GL_COMPRESSED_RGB_S3TC_DXT1_EXT.
+    // Only the opaque four colour mode is written, alpha decodes as 255
+    enum EBC1Quality
+    {
+        EBC1Quality_Fast = 0,   // endpoints from the block's colour bounding box
+        EBC1Quality_Normal,     // endpoints along the block's principal axis
+        EBC1Quality_High        // principal axis then least squares endpoint refinement
+    };
+
+    const size_t cBC1BlockSize = 8;
+
+    size_t GetBC1Size(uint16_t width, uint16_t height);
+
+    // width x height RGBA lumels to GetBC1Size() bytes of blocks, partial edge blocks repeat
+    // the last row and column
+    void EncodeBC1(const unsigned char* rgba, uint16_t width, uint16_t height, EBC1Quality quality,
+            unsigned char* blocks);
+
+    void DecodeBC1(const unsigned char* blocks, uint16_t width, uint16_t height, unsigned char* rgba);
+
+    // sum of squared RGB differences between two RGBA images, for GetPSNR()
+    uint64_t GetSquaredError(const unsigned char* rgbaA, const unsigned char* rgbaB, size_t numLumels);
+
+    // peak signal to noise ratio in dB over numSamples colour channels, 99 when lossless
+    double GetPSNR(uint64_t squaredError, size_t numSamples);
+};
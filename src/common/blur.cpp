@@ -0,0 +1,340 @@
+#include <algorithm>
+#include <cstddef>
+#include "blur.h"
+
+#if defined(__AVX2__)
+#define RADE_BLUR_AVX2 1
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define RADE_BLUR_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace rade
+{
+    namespace blur
+    {
+        namespace
+        {
+            // the byte path keeps its sums in 16 bits, so the weights never add up past this
+            const int cMaxWeightSum = 256;
+
+#if RADE_BLUR_AVX2
+            typedef __m256i vint;
+            typedef __m256 vfloat;
+            const size_t cLanes = 32;
+
+            inline vint vLoad(const unsigned char* p) { return _mm256_loadu_si256(reinterpret_cast<const vint*>(p)); }
+            inline void vStore(unsigned char* p, vint a) { _mm256_storeu_si256(reinterpret_cast<vint*>(p), a); }
+            inline vint vZero() { return _mm256_setzero_si256(); }
+            inline vint vSet16(int i) { return _mm256_set1_epi16(static_cast<short>(i)); }
+            inline vint vWidenLow(vint a) { return _mm256_unpacklo_epi8(a, _mm256_setzero_si256()); }
+            inline vint vWidenHigh(vint a) { return _mm256_unpackhi_epi8(a, _mm256_setzero_si256()); }
+            inline vint vAdd16(vint a, vint b) { return _mm256_add_epi16(a, b); }
+            inline vint vMul16(vint a, vint b) { return _mm256_mullo_epi16(a, b); }
+            inline vint vMulHigh16(vint a, vint b) { return _mm256_mulhi_epu16(a, b); }
+            inline vint vNarrow(vint low, vint high) { return _mm256_packus_epi16(low, high); }
+
+            inline vfloat vLoad(const float* p) { return _mm256_loadu_ps(p); }
+            inline void vStore(float* p, vfloat a) { _mm256_storeu_ps(p, a); }
+            inline vfloat vSet(float f) { return _mm256_set1_ps(f); }
+            inline vfloat vAdd(vfloat a, vfloat b) { return _mm256_add_ps(a, b); }
+            inline vfloat vMul(vfloat a, vfloat b) { return _mm256_mul_ps(a, b); }
+#elif RADE_BLUR_SSE2
+            typedef __m128i vint;
+            typedef __m128 vfloat;
+            const size_t cLanes = 16;
+
+            inline vint vLoad(const unsigned char* p) { return _mm_loadu_si128(reinterpret_cast<const vint*>(p)); }
+            inline void vStore(unsigned char* p, vint a) { _mm_storeu_si128(reinterpret_cast<vint*>(p), a); }
+            inline vint vZero() { return _mm_setzero_si128(); }
+            inline vint vSet16(int i) { return _mm_set1_epi16(static_cast<short>(i)); }
+            inline vint vWidenLow(vint a) { return _mm_unpacklo_epi8(a, _mm_setzero_si128()); }
+            inline vint vWidenHigh(vint a) { return _mm_unpackhi_epi8(a, _mm_setzero_si128()); }
+            inline vint vAdd16(vint a, vint b) { return _mm_add_epi16(a, b); }
+            inline vint vMul16(vint a, vint b) { return _mm_mullo_epi16(a, b); }
+            inline vint vMulHigh16(vint a, vint b) { return _mm_mulhi_epu16(a, b); }
+            inline vint vNarrow(vint low, vint high) { return _mm_packus_epi16(low, high); }
+
+            inline vfloat vLoad(const float* p) { return _mm_loadu_ps(p); }
+            inline void vStore(float* p, vfloat a) { _mm_storeu_ps(p, a); }
+            inline vfloat vSet(float f) { return _mm_set1_ps(f); }
+            inline vfloat vAdd(vfloat a, vfloat b) { return _mm_add_ps(a, b); }
+            inline vfloat vMul(vfloat a, vfloat b) { return _mm_mul_ps(a, b); }
+#endif
+
+            template<typename T>
+            struct blurtraits_t;
+
+            template<>
+            struct blurtraits_t<unsigned char>
+            {
+                typedef uint32_t acc_t;
+
+                // rounded divide. The masked lumels renormalise to sums the fixed point
+                // reciprocal of the runs is not exact for, and a flat area has to stay flat
+                static unsigned char Resolve(acc_t acc, int weightSum)
+                {
+                    return static_cast<unsigned char>((acc + weightSum / 2) / static_cast<uint32_t>(weightSum));
+                }
+            };
+
+            template<>
+            struct blurtraits_t<float>
+            {
+                typedef float acc_t;
+
+                static float Resolve(acc_t acc, int weightSum)
+                {
+                    return acc * (1.0f / static_cast<float>(weightSum));
+                }
+            };
+
+            // 2 * radius + 1 tap weights, returns their sum
+            int GetWeights(EKernel kernel, int radius, int* weights)
+            {
+                int numTaps = radius * 2 + 1;
+                int binomial = 1;
+                int weightSum = 0;
+                for (int i = 0; i < numTaps; i++)
+                {
+                    weights[i] = kernel == EKernel_Gaussian ? binomial : 1;
+                    weightSum += weights[i];
+                    binomial = binomial * (numTaps - 1 - i) / (i + 1);
+                }
+
+                // wide gaussians are scaled down to fit, the tails keep a weight of at least one
+                if (weightSum > cMaxWeightSum)
+                {
+                    int scaledSum = 0;
+                    for (int i = 0; i < numTaps; i++)
+                    {
+                        weights[i] = weights[i] * (cMaxWeightSum - numTaps) / weightSum + 1;
+                        scaledSum += weights[i];
+                    }
+                    weightSum = scaledSum;
+                }
+                return weightSum;
+            }
+
+            // dst[i] = the weighted sum of taps[t][i] over count bytes
+            void BlurRun(const unsigned char* const* taps, const int* weights, int numTaps, int weightSum,
+                    size_t count, unsigned char* dst)
+            {
+                size_t i = 0;
+#if RADE_BLUR_AVX2 || RADE_BLUR_SSE2
+                // widened to 16 bit lanes, then back through a fixed point reciprocal
+                vint half = vSet16(weightSum / 2);
+                vint scale = vSet16(static_cast<int>(65536u / static_cast<uint32_t>(weightSum)));
+                for (; i + cLanes <= count; i += cLanes)
+                {
+                    vint low = vZero();
+                    vint high = vZero();
+                    for (int t = 0; t < numTaps; t++)
+                    {
+                        vint tap = vLoad(taps[t] + i);
+                        vint weight = vSet16(weights[t]);
+                        low = vAdd16(low, vMul16(vWidenLow(tap), weight));
+                        high = vAdd16(high, vMul16(vWidenHigh(tap), weight));
+                    }
+                    low = vMulHigh16(vAdd16(low, half), scale);
+                    high = vMulHigh16(vAdd16(high, half), scale);
+                    vStore(dst + i, vNarrow(low, high));
+                }
+#endif
+                // the tail through the same reciprocal, so a run gives the same bytes whatever
+                // its length
+                uint32_t runScale = 65536u / static_cast<uint32_t>(weightSum);
+                for (; i < count; i++)
+                {
+                    uint32_t acc = 0;
+                    for (int t = 0; t < numTaps; t++)
+                        acc += static_cast<uint32_t>(weights[t]) * taps[t][i];
+                    dst[i] = static_cast<unsigned char>(((acc + weightSum / 2) * runScale) >> 16);
+                }
+            }
+
+            void BlurRun(const float* const* taps, const int* weights, int numTaps, int weightSum,
+                    size_t count, float* dst)
+            {
+                float scale = 1.0f / static_cast<float>(weightSum);
+                size_t i = 0;
+#if RADE_BLUR_AVX2 || RADE_BLUR_SSE2
+                const size_t cFloatLanes = cLanes / 4;
+                for (; i + cFloatLanes <= count; i += cFloatLanes)
+                {
+                    vfloat acc = vSet(0.0f);
+                    for (int t = 0; t < numTaps; t++)
+                        acc = vAdd(acc, vMul(vLoad(taps[t] + i), vSet(static_cast<float>(weights[t]))));
+                    vStore(dst + i, vMul(acc, vSet(scale)));
+                }
+#endif
+                for (; i < count; i++)
+                {
+                    float acc = 0.0f;
+                    for (int t = 0; t < numTaps; t++)
+                        acc += static_cast<float>(weights[t]) * taps[t][i];
+                    dst[i] = acc * scale;
+                }
+            }
+
+            // one lumel from src + offsets[t] * tChannels. With a tap mask the taps outside it
+            // are dropped and the rest renormalised, the lumel itself is always inside
+            template<typename T, int tChannels>
+            void BlurLumel(const T* src, const int* offsets, const uint8_t* tapMask, const int* weights,
+                    int numTaps, int weightSum, T* dst)
+            {
+                typedef blurtraits_t<T> traits_t;
+                typedef typename traits_t::acc_t acc_t;
+
+                acc_t acc[tChannels] = {};
+                if (tapMask)
+                    weightSum = 0;
+                for (int t = 0; t < numTaps; t++)
+                {
+                    if (tapMask && !tapMask[t])
+                        continue;
+                    if (tapMask)
+                        weightSum += weights[t];
+                    for (int c = 0; c < tChannels; c++)
+                        acc[c] += static_cast<acc_t>(weights[t]) * src[offsets[t] * tChannels + c];
+                }
+                for (int c = 0; c < tChannels; c++)
+                    dst[c] = traits_t::Resolve(acc[c], weightSum);
+            }
+
+            template<typename T, int tChannels>
+            void HorizontalPass(const T* src, T* dst, int width, int height, const int* weights, int radius,
+                    int weightSum, const uint8_t* mask)
+            {
+                int numTaps = radius * 2 + 1;
+                size_t rowSize = static_cast<size_t>(width) * tChannels;
+                int offsets[cMaxRadius * 2 + 1];
+                uint8_t tapMask[cMaxRadius * 2 + 1];
+                const T* taps[cMaxRadius * 2 + 1];
+
+                // without a mask the lumels whose taps all land inside the row go as a single run
+                int runStart = mask ? width : std::min(radius, width);
+                int runEnd = mask ? width : std::max(width - radius, runStart);
+
+                for (int y = 0; y < height; y++)
+                {
+                    const T* srcRow = src + y * rowSize;
+                    T* dstRow = dst + y * rowSize;
+                    const uint8_t* maskRow = mask ? mask + static_cast<size_t>(y) * width : nullptr;
+
+                    if (runEnd > runStart)
+                    {
+                        for (int t = 0; t < numTaps; t++)
+                            taps[t] = srcRow + (runStart + t - radius) * tChannels;
+                        BlurRun(taps, weights, numTaps, weightSum, static_cast<size_t>(runEnd - runStart) * tChannels,
+                                dstRow + runStart * tChannels);
+                    }
+
+                    for (int x = 0; x < width; x++)
+                    {
+                        if (x == runStart)
+                        {
+                            x = runEnd;
+                            if (x >= width)
+                                break;
+                        }
+
+                        T* dstLumel = dstRow + x * tChannels;
+                        if (maskRow && !maskRow[x])
+                        {
+                            std::copy(srcRow + x * tChannels, srcRow + (x + 1) * tChannels, dstLumel);
+                            continue;
+                        }
+
+                        for (int t = 0; t < numTaps; t++)
+                        {
+                            offsets[t] = std::min(std::max(x + t - radius, 0), width - 1);
+                            tapMask[t] = maskRow ? maskRow[offsets[t]] : 1;
+                        }
+                        BlurLumel<T, tChannels>(srcRow, offsets, maskRow ? tapMask : nullptr, weights, numTaps,
+                                weightSum, dstLumel);
+                    }
+                }
+            }
+
+            template<typename T, int tChannels>
+            void VerticalPass(const T* src, T* dst, int width, int height, const int* weights, int radius,
+                    int weightSum, const uint8_t* mask)
+            {
+                int numTaps = radius * 2 + 1;
+                size_t rowSize = static_cast<size_t>(width) * tChannels;
+                int rowIndex[cMaxRadius * 2 + 1];
+                int offsets[cMaxRadius * 2 + 1];
+                uint8_t tapMask[cMaxRadius * 2 + 1];
+                const T* taps[cMaxRadius * 2 + 1];
+
+                for (int y = 0; y < height; y++)
+                {
+                    for (int t = 0; t < numTaps; t++)
+                    {
+                        rowIndex[t] = std::min(std::max(y + t - radius, 0), height - 1);
+                        taps[t] = src + rowIndex[t] * rowSize;
+                    }
+                    T* dstRow = dst + y * rowSize;
+
+                    // rows past the top and bottom repeat the edge row, so every row is one run
+                    if (!mask)
+                    {
+                        BlurRun(taps, weights, numTaps, weightSum, rowSize, dstRow);
+                        continue;
+                    }
+
+                    const T* srcRow = src + y * rowSize;
+                    for (int x = 0; x < width; x++)
+                    {
+                        T* dstLumel = dstRow + x * tChannels;
+                        if (!mask[static_cast<size_t>(y) * width + x])
+                        {
+                            std::copy(srcRow + x * tChannels, srcRow + (x + 1) * tChannels, dstLumel);
+                            continue;
+                        }
+
+                        for (int t = 0; t < numTaps; t++)
+                        {
+                            offsets[t] = rowIndex[t] * width + x;
+                            tapMask[t] = mask[offsets[t]];
+                        }
+                        BlurLumel<T, tChannels>(src, offsets, tapMask, weights, numTaps, weightSum, dstLumel);
+                    }
+                }
+            }
+
+            template<typename T, int tChannels>
+            void Blur(T* image, T* scratch, int width, int height, EKernel kernel, int radius, const uint8_t* mask)
+            {
+                radius = std::min(radius, cMaxRadius);
+                if (radius <= 0 || width <= 0 || height <= 0)
+                    return;
+
+                int weights[cMaxRadius * 2 + 1];
+                int weightSum = GetWeights(kernel, radius, weights);
+                HorizontalPass<T, tChannels>(image, scratch, width, height, weights, radius, weightSum, mask);
+                VerticalPass<T, tChannels>(scratch, image, width, height, weights, radius, weightSum, mask);
+            }
+        }
+
+        void BlurRGBA(unsigned char* pixels, unsigned char* scratch, int width, int height,
+                EKernel kernel, int radius, const uint8_t* mask)
+        {
+            Blur<unsigned char, 4>(pixels, scratch, width, height, kernel, radius, mask);
+        }
+
+        void BlurRGB(unsigned char* pixels, unsigned char* scratch, int width, int height,
+                EKernel kernel, int radius, const uint8_t* mask)
+        {
+            Blur<unsigned char, 3>(pixels, scratch, width, height, kernel, radius, mask);
+        }
+
+        void BlurPlane(float* plane, float* scratch, int width, int height,
+                EKernel kernel, int radius, const uint8_t* mask)
+        {
+            Blur<float, 1>(plane, scratch, width, height, kernel, radius, mask);
+        }
+    }
+};
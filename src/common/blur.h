@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstdint>
+
+namespace rade
+{
+    // separable blurs for lightmaps. A horizontal pass goes from the image into scratch and a
+    // vertical pass back, taps past the border repeat the edge. With a mask only lumels with a
+    // non zero mask are blurred, and they only read other masked in lumels
+    namespace blur
+    {
+        enum EKernel
+        {
+            EKernel_Box = 0,
+            EKernel_Gaussian        // binomial weights, 1 2 1 at radius 1
+        };
+
+        const int cMaxRadius = 8;
+
+        // width x height RGBA pixels, all four channels. scratch holds width * height * 4 bytes
+        void BlurRGBA(unsigned char* pixels, unsigned char* scratch, int width, int height,
+                EKernel kernel, int radius, const uint8_t* mask = nullptr);
+
+        // width x height RGB pixels, scratch holds width * height * 3 bytes
+        void BlurRGB(unsigned char* pixels, unsigned char* scratch, int width, int height,
+                EKernel kernel, int radius, const uint8_t* mask = nullptr);
+
+        // one float channel, scratch holds width * height floats
+        void BlurPlane(float* plane, float* scratch, int width, int height,
+                EKernel kernel, int radius, const uint8_t* mask = nullptr);
+    }
+};
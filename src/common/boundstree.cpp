@@ -0,0 +1,150 @@
+#include <algorithm>
+#include <limits>
+#include "boundstree.h"
+
+namespace rade
+{
+    namespace
+    {
+        const uint32_t cMaxLeafBoxes = 4;
+
+        void ClearBox(BoundsTree::box_t& box)
+        {
+            for (int axis = 0; axis < 3; axis++)
+            {
+                box.min[axis] = std::numeric_limits<float>::max();
+                box.max[axis] = -std::numeric_limits<float>::max();
+            }
+        }
+
+        void GrowBox(BoundsTree::box_t& box, const BoundsTree::box_t& other)
+        {
+            for (int axis = 0; axis < 3; axis++)
+            {
+                box.min[axis] = std::min(box.min[axis], other.min[axis]);
+                box.max[axis] = std::max(box.max[axis], other.max[axis]);
+            }
+        }
+    }
+
+    void BoundsTree::Clear()
+    {
+        m_nodes.clear();
+        m_boxIndices.clear();
+        m_numBoxes = 0;
+    }
+
+    void BoundsTree::Build(const std::vector<box_t>& boxes)
+    {
+        Clear();
+        m_numBoxes = boxes.size();
+        if (boxes.empty())
+            return;
+
+        m_boxIndices.resize(boxes.size());
+        for (uint32_t i = 0; i < m_boxIndices.size(); i++)
+            m_boxIndices[i] = i;
+
+        m_nodes.reserve(boxes.size() * 2);
+        node_t root{};
+        root.first = 0;
+        root.count = static_cast<uint32_t>(boxes.size());
+        m_nodes.push_back(root);
+
+        // median split on the longest axis of the box centers, the trees are small and built once
+        std::vector<uint32_t> pending;
+        pending.push_back(0);
+        while (!pending.empty())
+        {
+            uint32_t current = pending.back();
+            pending.pop_back();
+
+            node_t& node = m_nodes[current];
+            ClearBox(node.bounds);
+            box_t centers;
+            ClearBox(centers);
+            for (uint32_t i = node.first; i < node.first + node.count; i++)
+            {
+                const box_t& box = boxes[m_boxIndices[i]];
+                GrowBox(node.bounds, box);
+                for (int axis = 0; axis < 3; axis++)
+                {
+                    float center = (box.min[axis] + box.max[axis]) * 0.5f;
+                    centers.min[axis] = std::min(centers.min[axis], center);
+                    centers.max[axis] = std::max(centers.max[axis], center);
+                }
+            }
+
+            if (node.count <= cMaxLeafBoxes)
+                continue;
+
+            int axis = 0;
+            for (int a = 1; a < 3; a++)
+            {
+                if (centers.max[a] - centers.min[a] > centers.max[axis] - centers.min[axis])
+                    axis = a;
+            }
+
+            uint32_t first = node.first;
+            uint32_t count = node.count;
+            uint32_t half = count / 2;
+            std::nth_element(m_boxIndices.begin() + first, m_boxIndices.begin() + first + half,
+                    m_boxIndices.begin() + first + count,
+                    [&boxes, axis](uint32_t a, uint32_t b)
+                    {
+                        return boxes[a].min[axis] + boxes[a].max[axis] < boxes[b].min[axis] + boxes[b].max[axis];
+                    });
+
+            // the reserve above keeps node valid through the push_backs
+            auto left = static_cast<uint32_t>(m_nodes.size());
+            node.left = left;
+
+            node_t child{};
+            child.first = first;
+            child.count = half;
+            m_nodes.push_back(child);
+            child.first = first + half;
+            child.count = count - half;
+            m_nodes.push_back(child);
+
+            pending.push_back(left);
+            pending.push_back(left + 1);
+        }
+    }
+
+    bool BoundsTree::GetBounds(box_t* bounds) const
+    {
+        if (m_nodes.empty())
+            return false;
+        *bounds = m_nodes[0].bounds;
+        return true;
+    }
+
+    void BoundsTree::CullFrustrum(const Frustrum& frustrum, std::vector<uint8_t>& visible) const
+    {
+        visible.assign(m_numBoxes, 0);
+        if (m_nodes.empty())
+            return;
+
+        uint32_t stack[64];
+        int stackSize = 0;
+        stack[stackSize++] = 0;
+        while (stackSize > 0)
+        {
+            const node_t& node = m_nodes[stack[--stackSize]];
+            rade::math::ESide side = frustrum.ClassifyBox(node.bounds.min, node.bounds.max);
+            if (side == rade::math::ESide_BACK)
+                continue;
+
+            if (side == rade::math::ESide_FRONT || node.left == 0)
+            {
+                for (uint32_t i = node.first; i < node.first + node.count; i++)
+                    visible[m_boxIndices[i]] = 1;
+                continue;
+            }
+
+            stack[stackSize++] = node.left;
+            stack[stackSize++] = node.left + 1;
+        }
+    }
+};
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include "frustrum.h"
+
+namespace rade
+{
+    // bounding volume hierarchy over a list of boxes, for culling whole groups of them against a
+    // frustum. Built once when the boxes are known, every node keeps the run of box indices
+    // under it so a node fully in view takes all its boxes without testing them
+    class BoundsTree
+    {
+    public:
+
+        typedef struct
+        {
+            float min[3];
+            float max[3];
+        } box_t;
+
+        void Build(const std::vector<box_t>& boxes);
+
+        void Clear();
+
+        bool IsBuilt() const
+        {
+            return !m_nodes.empty();
+        }
+
+        // bounds of every box in the tree, false if it is empty
+        bool GetBounds(box_t* bounds) const;
+
+        // visible[i] is 1 for every box in or crossing the frustum and 0 for the rest, the
+        // frustum planes must be in the same space as the boxes
+        void CullFrustrum(const Frustrum& frustrum, std::vector<uint8_t>& visible) const;
+
+    private:
+
+        typedef struct
+        {
+            box_t bounds;
+            uint32_t first;     // first entry in m_boxIndices
+            uint32_t count;
+            uint32_t left;      // children are left and left + 1, 0 for leaves
+        } node_t;
+
+        std::vector<node_t> m_nodes;
+        std::vector<uint32_t> m_boxIndices;
+        size_t m_numBoxes = 0;
+    };
+};
@@ -0,0 +1,98 @@
+#pragma once
+#include <cmath>
+
+#include "point3d.h"
+
+namespace rade
+{
+    // position, direction or colour only. vector3 also carries a normal, uv sets and flags, so
+    // the baker works on these and only converts at the poly3d boundary. The maths matches
+    // vector3 operation for operation so results do not change
+    class float3
+    {
+
+    public:
+        float x = 0.0f;
+        float y = 0.0f;
+        float z = 0.0f;
+
+        float3()
+        = default;
+
+        float3(float a, float b, float c)
+                : x(a), y(b), z(c)
+        {
+        }
+
+        explicit float3(const float* vec)
+                : x(vec[0]), y(vec[1]), z(vec[2])
+        {
+        }
+
+        explicit float3(const vector3& vec)
+                : x(vec.x), y(vec.y), z(vec.z)
+        {
+        }
+
+        vector3 ToVector3() const
+        {
+            return { x, y, z };
+        }
+
+        void Scale(float s)
+        {
+            x *= s;
+            y *= s;
+            z *= s;
+        }
+
+        float3 Normalize()
+        {
+            float length = sqrtf(x * x + y * y + z * z);
+            if (length > 0.0f)
+            {
+                float ilength = 1 / length;
+                x *= ilength;
+                y *= ilength;
+                z *= ilength;
+            }
+            return *this;
+        }
+
+        float3 operator+(const float3& v) const
+        {
+            return { x + v.x, y + v.y, z + v.z };
+        }
+
+        float3 operator-(const float3& v) const
+        {
+            return { x - v.x, y - v.y, z - v.z };
+        }
+
+        float3 operator*(float a) const
+        {
+            return { x * a, y * a, z * a };
+        }
+
+        float Dot(const float3& p) const
+        {
+            return x * p.x + y * p.y + z * p.z;
+        }
+
+        float Distance(const float3& p) const
+        {
+            float dx = p.x - x;
+            float dy = p.y - y;
+            float dz = p.z - z;
+            return sqrtf(dx * dx + dy * dy + dz * dz);
+        }
+
+        float3 CrossProduct(const float3& p2) const
+        {
+            return {
+                    y * p2.z - z * p2.y,
+                    z * p2.x - x * p2.z,
+                    x * p2.y - y * p2.x };
+        }
+    };
+};
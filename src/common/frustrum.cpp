@@ -56,4 +56,32 @@ namespace rade
 
         return true;
     }
+
+    rade::math::ESide Frustrum::ClassifyBox(const float* min, const float* max) const
+    {
+        using namespace rade::math;
+        const rade::plane3d* planes[] = { &m_plane_left, &m_plane_right, &m_plane_bottom,
+                &m_plane_top, &m_plane_near, &m_plane_far };
+
+        ESide side = ESide_FRONT;
+        for (const rade::plane3d* plane : planes)
+        {
+            // the corners furthest along and furthest against the plane normal
+            rade::vector3 normal = plane->GetNormal();
+            float n[3] = { normal.x, normal.y, normal.z };
+            float front = plane->GetDistance();
+            float back = plane->GetDistance();
+            for (int axis = 0; axis < 3; axis++)
+            {
+                front += n[axis] * (n[axis] >= 0.0f ? max[axis] : min[axis]);
+                back += n[axis] * (n[axis] >= 0.0f ? min[axis] : max[axis]);
+            }
+
+            if (front < 0.0f)
+                return ESide_BACK;
+            if (back < 0.0f)
+                side = ESide_SPAN;
+        }
+        return side;
+    }
 }
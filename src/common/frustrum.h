@@ -16,6 +16,11 @@ namespace rade
 
         bool IsInsideFrustrum(const rade::vector3& point);
 
+        // ESide_FRONT for a box fully inside, ESide_BACK for one fully outside and ESide_SPAN
+        // for one crossing a plane. Boxes near a corner can come back as ESide_SPAN while
+        // being outside, they are never wrongly culled
+        rade::math::ESide ClassifyBox(const float* min, const float* max) const;
+
     private:
         rade::plane3d m_plane_left      {0.0f, 0.0f, 0.0f, 0.0f};
         rade::plane3d m_plane_right     {0.0f, 0.0f, 0.0f, 0.0f};
@@ -1,4 +1,5 @@
 #include "image.h"
+#include "blur.h"
 #include <cstdlib>
 #include <vector>
 
@@ -207,62 +208,19 @@ namespace rade
 
     void Image::Blur()
     {
-        struct blurKernel_t
+        // radius 1 gaussian, the blur kernels only take 3 and 4 channel images
+        if (m_format != Format_RGB && m_format != Format_RGBA)
         {
-            int xOffset;
-            int yOffset;
-            float weight;
-        };
-
-        std::vector<blurKernel_t> blurKernel = {
-                { -1, -1, 0.2f },  // TL
-                { 0,  -1, 0.2f },  // TM
-                { 1,  1,  0.2f },  // TR
-                { -1, 0,  0.2f },  // CL
-                { 0,  0,  0.3f },  // C
-                { 1,  0,  0.2f },  // CR
-                { -1, 1,  0.2f },  // BL
-                { 0,  1,  0.2f },  // BM
-                { 1,  1,  0.2f }   // BR
-        };
-
-        float totalWeight = 0.0f;
-        for (auto & kern : blurKernel)
-        {
-            totalWeight += kern.weight;
+            rade::Log("Blur skipped, the image has %d channels\n", static_cast<int>(m_format));
+            return;
         }
 
-        auto newPixels = (unsigned char*)malloc(m_format * m_width * m_height);
-
-        for (unsigned iX = 0; iX < m_width; ++iX)
-        {
-            for (unsigned iY = 0; iY < m_height; ++iY)
-            {
-                float avg_rgba[4] = { 0, 0, 0, 0 }; // allow over "saturation" and divide later
-                for (auto & kern : blurKernel)
-                {
-                    unsigned char rgba[4];
-                    GetRGBAArray(iX + kern.xOffset, iY + kern.yOffset, rgba);
-
-                    float multiplierAvg = kern.weight / totalWeight;
-                    avg_rgba[0] += (float)rgba[0] * multiplierAvg;
-                    avg_rgba[1] += (float)rgba[1] * multiplierAvg;
-                    avg_rgba[2] += (float)rgba[2] * multiplierAvg;
-                }
-
-                unsigned char final_rgba[4];
-                final_rgba[0] = static_cast<unsigned char>(avg_rgba[0]);
-                final_rgba[1] = static_cast<unsigned char>(avg_rgba[1]);
-                final_rgba[2] = static_cast<unsigned char>(avg_rgba[2]);
-                final_rgba[3] = 255; //avg_rgba[3];
-
-                unsigned int destOffset = GetPixelOffset(iX, iY, m_width, m_format);
-                memcpy(newPixels + destOffset, final_rgba, 4); //copy one pixel
-            }
-        }
-
-        free(m_pixels);
-        m_pixels = newPixels;
+        auto scratch = (unsigned char*)malloc(m_format * m_width * m_height);
+        if (m_format == Format_RGBA)
+            blur::BlurRGBA(m_pixels, scratch, m_width, m_height, blur::EKernel_Gaussian, 1);
+        else
+            blur::BlurRGB(m_pixels, scratch, m_width, m_height, blur::EKernel_Gaussian, 1);
+        free(scratch);
     }
 
     void Image::Set(unsigned width,
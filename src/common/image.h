@@ -69,6 +69,7 @@ namespace rade
 
         void GetRGBAArray(int col, int row, unsigned char* rgba);
 
+        // Radius 1 gaussian blur. Only RGB and RGBA images are blurred, other formats are left as they are.
         void Blur();
 
     private:
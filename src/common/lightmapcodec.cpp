@@ -0,0 +1,343 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include "lightmapcodec.h"
+#include "miniz.h"
+
+namespace rade
+{
+    namespace
+    {
+        // PNG filter types, one byte ahead of every row of every plane
+        enum EFilter
+        {
+            EFilter_None = 0,
+            EFilter_Sub,
+            EFilter_Up,
+            EFilter_Average,
+            EFilter_Paeth,
+            EFilter_Count
+        };
+
+        inline unsigned char Paeth(int left, int up, int upLeft)
+        {
+            int p = left + up - upLeft;
+            int pa = std::abs(p - left);
+            int pb = std::abs(p - up);
+            int pc = std::abs(p - upLeft);
+            if (pa <= pb && pa <= pc)
+                return static_cast<unsigned char>(left);
+            if (pb <= pc)
+                return static_cast<unsigned char>(up);
+            return static_cast<unsigned char>(upLeft);
+        }
+
+        inline unsigned char Predict(int filter, const unsigned char* row, const unsigned char* prevRow, int x)
+        {
+            int left = x > 0 ? row[x - 1] : 0;
+            int up = prevRow ? prevRow[x] : 0;
+            int upLeft = (prevRow && x > 0) ? prevRow[x - 1] : 0;
+            switch (filter)
+            {
+            case EFilter_Sub:
+                return static_cast<unsigned char>(left);
+            case EFilter_Up:
+                return static_cast<unsigned char>(up);
+            case EFilter_Average:
+                return static_cast<unsigned char>((left + up) / 2);
+            case EFilter_Paeth:
+                return Paeth(left, up, upLeft);
+            default:
+                return 0;
+            }
+        }
+
+        // one plane, rows of (filter byte, width residuals). Each row takes the filter with the
+        // smallest sum of absolute residuals, the usual PNG heuristic
+        void FilterPlane(const unsigned char* plane, int width, int height, unsigned char* out)
+        {
+            std::vector<unsigned char> residuals(width);
+            for (int y = 0; y < height; y++)
+            {
+                const unsigned char* row = plane + y * width;
+                const unsigned char* prevRow = y > 0 ? row - width : nullptr;
+                unsigned char* outRow = out + y * (width + 1);
+
+                int bestFilter = EFilter_None;
+                int bestCost = -1;
+                for (int filter = EFilter_None; filter < EFilter_Count; filter++)
+                {
+                    int cost = 0;
+                    for (int x = 0; x < width; x++)
+                    {
+                        residuals[x] = static_cast<unsigned char>(row[x] - Predict(filter, row, prevRow, x));
+                        cost += std::abs(static_cast<int>(static_cast<signed char>(residuals[x])));
+                    }
+                    if (bestCost < 0 || cost < bestCost)
+                    {
+                        bestCost = cost;
+                        bestFilter = filter;
+                        memcpy(outRow + 1, residuals.data(), width);
+                    }
+                }
+                outRow[0] = static_cast<unsigned char>(bestFilter);
+            }
+        }
+
+        // writes the plane straight into every 4th byte of rgba, one loop per filter so the
+        // inner loops stay branch free
+        bool UnfilterPlane(const unsigned char* in, int width, int height, unsigned char* rgba)
+        {
+            const size_t stride = static_cast<size_t>(width) * 4;
+            std::vector<unsigned char> zeroRow(stride, 0);
+            for (int y = 0; y < height; y++)
+            {
+                const unsigned char* src = in + y * (width + 1) + 1;
+                unsigned char* row = rgba + y * stride;
+                const unsigned char* prev = y > 0 ? row - stride : zeroRow.data();
+
+                switch (in[y * (width + 1)])
+                {
+                case EFilter_None:
+                    for (int x = 0; x < width; x++)
+                        row[x * 4] = src[x];
+                    break;
+
+                case EFilter_Sub:
+                {
+                    unsigned char left = 0;
+                    for (int x = 0; x < width; x++)
+                    {
+                        left = static_cast<unsigned char>(src[x] + left);
+                        row[x * 4] = left;
+                    }
+                    break;
+                }
+
+                case EFilter_Up:
+                    for (int x = 0; x < width; x++)
+                        row[x * 4] = static_cast<unsigned char>(src[x] + prev[x * 4]);
+                    break;
+
+                case EFilter_Average:
+                {
+                    int left = 0;
+                    for (int x = 0; x < width; x++)
+                    {
+                        left = static_cast<unsigned char>(src[x] + ((left + prev[x * 4]) >> 1));
+                        row[x * 4] = static_cast<unsigned char>(left);
+                    }
+                    break;
+                }
+
+                case EFilter_Paeth:
+                {
+                    int left = 0;
+                    int upLeft = 0;
+                    for (int x = 0; x < width; x++)
+                    {
+                        int up = prev[x * 4];
+                        left = static_cast<unsigned char>(src[x] + Paeth(left, up, upLeft));
+                        row[x * 4] = static_cast<unsigned char>(left);
+                        upLeft = up;
+                    }
+                    break;
+                }
+
+                default:
+                    return false;
+                }
+            }
+            return true;
+        }
+    }
+
+    void EncodeRGBM(const float* rgb, unsigned char* rgbm)
+    {
+        float scale = 1.0f / (255.0f * cRGBMRange);
+        float r = std::min(std::max(rgb[0] * scale, 0.0f), 1.0f);
+        float g = std::min(std::max(rgb[1] * scale, 0.0f), 1.0f);
+        float b = std::min(std::max(rgb[2] * scale, 0.0f), 1.0f);
+
+        // smallest multiplier that still fits the brightest channel, rounded up so none overflow
+        float m = std::max(std::max(r, g), b);
+        int mByte = std::max(1, static_cast<int>(ceilf(m * 255.0f)));
+        float invM = 255.0f / static_cast<float>(mByte);
+
+        rgbm[0] = static_cast<unsigned char>(std::min(r * invM, 1.0f) * 255.0f + 0.5f);
+        rgbm[1] = static_cast<unsigned char>(std::min(g * invM, 1.0f) * 255.0f + 0.5f);
+        rgbm[2] = static_cast<unsigned char>(std::min(b * invM, 1.0f) * 255.0f + 0.5f);
+        rgbm[3] = static_cast<unsigned char>(mByte);
+    }
+
+    void DecodeRGBM(const unsigned char* rgbm, float* rgb)
+    {
+        float scale = rgbm[3] * cRGBMRange / 255.0f;
+        rgb[0] = rgbm[0] * scale;
+        rgb[1] = rgbm[1] * scale;
+        rgb[2] = rgbm[2] * scale;
+    }
+
+    void ToneMapRGBM(const unsigned char* rgbm, size_t numLumels, float exposure, unsigned char* rgba)
+    {
+        // below the knee the colour is left as baked, so a scene that never goes over white
+        // looks the same as an LDR bake
+        const float cKnee = 192.0f;
+        const float cShoulder = 255.0f - cKnee;
+
+        for (size_t i = 0; i < numLumels; i++)
+        {
+            float rgb[3];
+            DecodeRGBM(rgbm + i * 4, rgb);
+            for (int c = 0; c < 3; c++)
+            {
+                float v = rgb[c] * exposure;
+                if (v > cKnee)
+                    v = cKnee + cShoulder * (1.0f - expf(-(v - cKnee) / cShoulder));
+                rgba[i * 4 + c] = static_cast<unsigned char>(std::min(v, 255.0f));
+            }
+            rgba[i * 4 + 3] = 255;
+        }
+    }
+
+    bool EncodeLightmap(
+            const unsigned char* rgba,
+            uint16_t width,
+            uint16_t height,
+            int level,
+            std::vector<unsigned char>& out,
+            uint8_t* outCodec)
+    {
+        size_t numLumels = static_cast<size_t>(width) * height;
+
+        // lightmaps are written with alpha 255, only keep the plane when something else is in it
+        bool opaque = true;
+        for (size_t i = 0; i < numLumels && opaque; i++)
+            opaque = rgba[i * 4 + 3] == 255;
+        int numPlanes = opaque ? 3 : 4;
+
+        std::vector<unsigned char> plane(numLumels);
+        std::vector<unsigned char> filtered(numPlanes * height * (static_cast<size_t>(width) + 1));
+        for (int p = 0; p < numPlanes; p++)
+        {
+            for (size_t i = 0; i < numLumels; i++)
+                plane[i] = rgba[i * 4 + p];
+            FilterPlane(plane.data(), width, height, &filtered[p * height * (static_cast<size_t>(width) + 1)]);
+        }
+
+        mz_ulong outSize = compressBound(static_cast<mz_ulong>(filtered.size()));
+        out.resize(outSize);
+        int result = compress2(out.data(), &outSize, filtered.data(), static_cast<mz_ulong>(filtered.size()),
+                std::min(std::max(level, 0), cMaxLightmapCompressionLevel));
+        if (result != Z_OK)
+            return false;
+
+        out.resize(outSize);
+        *outCodec = opaque ? ELightmapCodec_PlaneDeltaRGB : ELightmapCodec_PlaneDeltaRGBA;
+        return true;
+    }
+
+    bool EncodeLightmapBC1(
+            const unsigned char* rgba,
+            uint16_t width,
+            uint16_t height,
+            int level,
+            EBC1Quality quality,
+            std::vector<unsigned char>& out,
+            uint8_t* outCodec,
+            uint64_t* squaredError)
+    {
+        size_t numLumels = static_cast<size_t>(width) * height;
+        std::vector<unsigned char> blocks(GetBC1Size(width, height));
+        EncodeBC1(rgba, width, height, quality, blocks.data());
+
+        std::vector<unsigned char> decoded(numLumels * 4);
+        DecodeBC1(blocks.data(), width, height, decoded.data());
+        *squaredError = GetSquaredError(rgba, decoded.data(), numLumels);
+
+        mz_ulong outSize = compressBound(static_cast<mz_ulong>(blocks.size()));
+        out.resize(outSize);
+        int result = compress2(out.data(), &outSize, blocks.data(), static_cast<mz_ulong>(blocks.size()),
+                std::min(std::max(level, 0), cMaxLightmapCompressionLevel));
+        if (result != Z_OK)
+            return false;
+
+        out.resize(outSize);
+        *outCodec = ELightmapCodec_BC1;
+        return true;
+    }
+
+    bool DecodeLightmap(
+            uint8_t codec,
+            const unsigned char* payload,
+            size_t payloadSize,
+            uint16_t width,
+            uint16_t height,
+            unsigned char* rgba)
+    {
+        size_t numLumels = static_cast<size_t>(width) * height;
+        switch (codec & cLightmapCodecMask)
+        {
+        case ELightmapCodec_Deflate:
+        {
+            mz_ulong size = static_cast<mz_ulong>(numLumels * 4);
+            return uncompress(rgba, &size, payload, static_cast<mz_ulong>(payloadSize)) == Z_OK &&
+                   size == numLumels * 4;
+        }
+
+        case ELightmapCodec_PlaneDeltaRGB:
+        case ELightmapCodec_PlaneDeltaRGBA:
+        {
+            int numPlanes = (codec & cLightmapCodecMask) == ELightmapCodec_PlaneDeltaRGB ? 3 : 4;
+            size_t planeSize = height * (static_cast<size_t>(width) + 1);
+            std::vector<unsigned char> filtered(numPlanes * planeSize);
+            mz_ulong size = static_cast<mz_ulong>(filtered.size());
+            if (uncompress(filtered.data(), &size, payload, static_cast<mz_ulong>(payloadSize)) != Z_OK ||
+                size != filtered.size())
+                return false;
+
+            for (int p = 0; p < numPlanes; p++)
+            {
+                if (!UnfilterPlane(&filtered[p * planeSize], width, height, rgba + p))
+                    return false;
+            }
+            if (numPlanes == 3)
+            {
+                for (size_t i = 0; i < numLumels; i++)
+                    rgba[i * 4 + 3] = 255;
+            }
+            return true;
+        }
+
+        case ELightmapCodec_BC1:
+        {
+            std::vector<unsigned char> blocks(GetBC1Size(width, height));
+            if (!DecodeLightmapBlocks(codec, payload, payloadSize, width, height, blocks.data()))
+                return false;
+            DecodeBC1(blocks.data(), width, height, rgba);
+            return true;
+        }
+
+        default:
+            return false;
+        }
+    }
+
+    bool DecodeLightmapBlocks(
+            uint8_t codec,
+            const unsigned char* payload,
+            size_t payloadSize,
+            uint16_t width,
+            uint16_t height,
+            unsigned char* blocks)
+    {
+        if ((codec & cLightmapCodecMask) != ELightmapCodec_BC1)
+            return false;
+
+        size_t blockSize = GetBC1Size(width, height);
+        mz_ulong size = static_cast<mz_ulong>(blockSize);
+        return uncompress(blocks, &size, payload, static_cast<mz_ulong>(payloadSize)) == Z_OK &&
+               size == blockSize;
+    }
+};
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "bc1codec.h"
+
+namespace rade
+{
+    // SLightmapHeader.compression, how a lightmap payload is encoded. The low nibble is the
+    // codec, the high nibble the ELightmapEncoding of the decoded lumels
+    enum ELightmapCodec
+    {
+        ELightmapCodec_Deflate = 0,         // interleaved RGBA, deflated (every file before the codecs)
+        ELightmapCodec_PlaneDeltaRGB,       // R, G, B planes with PNG row filters, deflated. Alpha is 255
+        ELightmapCodec_PlaneDeltaRGBA,      // as above plus an alpha plane, when alpha is not all 255
+        ELightmapCodec_BC1                  // BC1 blocks, deflated. Lossy, uploaded to the GPU as is
+    };
+
+    // what MeshFile::WriteToFile() stores lightmaps as
+    enum ELightmapStorage
+    {
+        ELightmapStorage_Lossless = 0,      // ELightmapCodec_PlaneDeltaRGB(A)
+        ELightmapStorage_BC1                // ELightmapCodec_BC1
+    };
+
+    const uint8_t cLightmapCodecMask = 0x0F;
+
+    // what the decoded RGBA lumels hold
+    enum ELightmapEncoding
+    {
+        ELightmapEncoding_LDR = 0,          // colour clamped to 0-255
+        ELightmapEncoding_RGBM              // RGB * A * cRGBMRange, up to cRGBMRange times full white
+    };
+
+    const int cLightmapEncodingShift = 4;
+    const float cRGBMRange = 8.0f;
+
+    inline uint8_t GetLightmapEncoding(uint8_t compression)
+    {
+        return static_cast<uint8_t>(compression >> cLightmapEncodingShift);
+    }
+
+    // rgb in baker units (255 = full white, may be above) to one RGBM lumel
+    void EncodeRGBM(const float* rgb, unsigned char* rgbm);
+
+    void DecodeRGBM(const unsigned char* rgbm, float* rgb);
+
+    // RGBM lumels to displayable RGBA. Colour is scaled by exposure, then anything above a knee
+    // rolls off towards white instead of clipping
+    void ToneMapRGBM(const unsigned char* rgbm, size_t numLumels, float exposure, unsigned char* rgba);
+
+    // miniz levels, 0 (store) to 10 (slowest, smallest)
+    const int cDefaultLightmapCompressionLevel = 6;
+    const int cMaxLightmapCompressionLevel = 10;
+
+    // encode width x height RGBA lumels, the codec chosen goes in outCodec
+    bool EncodeLightmap(
+            const unsigned char* rgba,
+            uint16_t width,
+            uint16_t height,
+            int level,
+            std::vector<unsigned char>& out,
+            uint8_t* outCodec);
+
+    // encode as ELightmapCodec_BC1, squaredError gets the RGB error against rgba for GetPSNR()
+    bool EncodeLightmapBC1(
+            const unsigned char* rgba,
+            uint16_t width,
+            uint16_t height,
+            int level,
+            EBC1Quality quality,
+            std::vector<unsigned char>& out,
+            uint8_t* outCodec,
+            uint64_t* squaredError);
+
+    // decode a payload to width x height RGBA lumels, rgba holds width * height * 4 bytes
+    bool DecodeLightmap(
+            uint8_t codec,
+            const unsigned char* payload,
+            size_t payloadSize,
+            uint16_t width,
+            uint16_t height,
+            unsigned char* rgba);
+
+    // the BC1 blocks of an ELightmapCodec_BC1 payload, GetBC1Size(width, height) bytes. False
+    // for any other codec
+    bool DecodeLightmapBlocks(
+            uint8_t codec,
+            const unsigned char* payload,
+            size_t payloadSize,
+            uint16_t width,
+            uint16_t height,
+            unsigned char* blocks);
+};
@@ -1,48 +1,65 @@
 #include <memory.h>
 #include <cstdio>
+#include <atomic>
+#include <functional>
+#include <thread>
 
 #include "meshfile.h"
-#include "miniz.h"
 #include "osutils.h"
+#include "taskscheduler.h"
+#include "lightmapcodec.h"
 
 namespace rade
 {
-    MeshFile::MeshFile()
+    namespace
     {
-        memset(&m_header, 0, sizeof(mesh::SMeshHeader));
-    }
+        poly3d ToPoly3d(const mesh::SPolyHeader& header, const mesh::SPolyPoint* points, const std::string& materialKey)
+        {
+            poly3d newPoly;
+            newPoly.SetMaterialKey(materialKey);
+            newPoly.SetLightmapDataIndex(header.lmIndex);
 
-    MeshFile::~MeshFile()
-    {
-        FreeAll();
-    }
+            for (uint32_t i = 0; i < header.numPoints; i++)
+            {
+                const mesh::SPolyPoint& spoint = points[i];
+                rade::vector3 p(spoint.point);
+                p.nx = spoint.nornmal[0];
+                p.ny = spoint.nornmal[1];
+                p.nz = spoint.nornmal[2];
+                p.u = spoint.uv0[0];
+                p.v = spoint.uv0[1];
+                p.lmU = spoint.uv1[0];
+                p.lmV = spoint.uv1[1];
+                newPoly.AddPoint(p);
+            }
+            newPoly.CalcNormal();
+            return newPoly;
+        }
 
-    unsigned char* MeshFile::CreateCompressedBuffer(
-            unsigned char* pData,
-            unsigned long nDataSize,
-            unsigned long* nCompressedDataSize)
-    {
-        *nCompressedDataSize = nDataSize;
-        auto* pCompressedData = new unsigned char[*nCompressedDataSize];
-        int nResult = compress(pCompressedData, nCompressedDataSize, pData, nDataSize);
-        if (nResult != Z_OK)
+        // lightmaps are independent blobs, so they are (de)compressed on every core. Each result
+        // lands in its own slot, so the file bytes do not depend on the thread count
+        void ForEachLightmap(size_t count, const std::function<void(size_t)>& fn)
         {
-            return nullptr;
+            if (count < 2)
+            {
+                for (size_t i = 0; i < count; i++)
+                    fn(i);
+                return;
+            }
+            unsigned int numThreads = std::min<unsigned int>(static_cast<unsigned int>(count), std::thread::hardware_concurrency());
+            TaskScheduler scheduler(numThreads);
+            scheduler.ParallelFor(count, fn);
         }
-        return pCompressedData;
     }
 
-    unsigned char* MeshFile::CreateUncompressedBuffer(unsigned char* pCompressedData,
-            unsigned long nCompressedDataSize,
-            unsigned long nOriginalDataSize)
+    MeshFile::MeshFile()
     {
-        auto* pUncompressedData = new unsigned char[nOriginalDataSize];
-        int nResult = uncompress(pUncompressedData, &nOriginalDataSize, pCompressedData, nCompressedDataSize);
-        if (nResult != Z_OK)
-        {
-            return nullptr;
-        }
-        return pUncompressedData;
+        memset(&m_header, 0, sizeof(mesh::SMeshHeader));
+    }
+
+    MeshFile::~MeshFile()
+    {
+        FreeAll();
     }
 
     void MeshFile::FreeAll()
@@ -68,84 +85,69 @@ namespace rade
 
     bool MeshFile::LoadFromFile(const std::string& filename)
     {
-        FILE* fp = fopen(filename.c_str(), "rb");
-        if (!fp)
+        MeshFileView view;
+        if (!view.Open(filename))
         {
             return false;
         }
 
         Reset();
+        DeleteLightmapData();
+        m_lights.clear();
 
-        fread((mesh::SMeshHeader*)&m_header, sizeof(mesh::SMeshHeader), 1, fp);
+        m_header = view.GetHeader();
 
         // materials
-        for (uint32_t i = 0; i < m_header.numMaterials; i++)
+        for (uint32_t i = 0; i < view.GetMaterialCount(); i++)
         {
             LogicalMaterial mat;
 
-            mesh::SMaterialHeader matHeader{};
-            fread((mesh::SMaterialHeader*)&matHeader, sizeof(mesh::SMaterialHeader), 1, fp);
-            mat.SetKey(matHeader.materialName);
+            const mesh::SMaterialHeader& matHeader = view.GetMaterialHeader(i);
+            mat.SetKey(std::string(matHeader.materialName, strnlen(matHeader.materialName, mesh::MATERIAL_NAME_LEN)));
 
+            const mesh::STextureKey* textureKeys = view.GetTextureKeys(i);
             for (int j = 0; j < matHeader.numTextureKeys; j++)
             {
-                mesh::STextureKey tex{};
-                fread((mesh::STextureKey*)&tex, sizeof(mesh::STextureKey), 1, fp);
+                mesh::STextureKey tex = textureKeys[j];
                 mat.AddTexture(tex.keyName, tex.fileName);
             }
             m_materials.push_back(mat);
         }
 
-        // polys
-        for (uint32_t i = 0; i < m_header.numFaces; i++)
+        // polys, the point records are copied as a block
+        m_polygons.resize(view.GetPolyCount());
+        for (uint32_t i = 0; i < view.GetPolyCount(); i++)
         {
-            LogicalPolygon poly;
-
-            mesh::SPolyHeader polyHeader{};
-            fread((mesh::SPolyHeader*)&polyHeader, sizeof(mesh::SPolyHeader), 1, fp);
+            const mesh::SPolyHeader& polyHeader = view.GetPolyHeader(i);
+            LogicalPolygon& poly = m_polygons[i];
             poly.SetMaterialIndex(polyHeader.matIndex);
             poly.SetLightmapDataIndex(polyHeader.lmIndex);
-
-            for (uint32_t j = 0; j < polyHeader.numPoints; j++)
-            {
-                mesh::SPolyPoint point;
-                fread((mesh::SPolyPoint*)&point, sizeof(mesh::SPolyPoint), 1, fp);
-                poly.AddPoint(point);
-            }
-            m_polygons.push_back(poly);
+            poly.SetPoints(view.GetPolyPoints(i), polyHeader.numPoints);
         }
 
-        // lightmaps
-        for (uint32_t i = 0; i < m_header.numLightmaps; i++)
+        // lightmaps, decompressed in parallel then copied in order
+        ForEachLightmap(view.GetLightmapCount(), [&view](size_t i)
         {
-            LogicalLightmap newLightmap;
-
-            size_t lmSize = sizeof(mesh::SLightmapHeader);
+            view.GetLightmapData(static_cast<uint32_t>(i));
+        });
 
-            mesh::SLightmapHeader lmHeader;
-            fread((mesh::SLightmapHeader*)&lmHeader, sizeof(mesh::SLightmapHeader), 1, fp);
-
-            auto* compressedBuffer = new unsigned char[lmHeader.compressedDataSize];
-            fread((unsigned char*)compressedBuffer, lmHeader.compressedDataSize, 1, fp);
-
-            mesh::SLightmap lightmap;
-            lightmap.data = CreateUncompressedBuffer(compressedBuffer, lmHeader.compressedDataSize, lmHeader.dataSize);
-            delete[] compressedBuffer;
-
-            newLightmap.AddLightmapData(lmHeader.width, lmHeader.height, lightmap.data, lmHeader.dataSize);
-            delete[] lightmap.data;
-
-            m_lightmaps.push_back(newLightmap);
-        }
-
-        for (uint32_t i = 0; i < m_header.numLights; i++)
+        m_header.numLightmaps = 0;
+        for (uint32_t i = 0; i < view.GetLightmapCount(); i++)
         {
-            mesh::SLight light;
-            fread((mesh::SLight*)&light, sizeof(mesh::SLight), 1, fp);
-            m_lights.push_back(light);
+            const mesh::SLightmapHeader& lmHeader = view.GetLightmapHeader(i);
+            const unsigned char* data = view.GetLightmapData(i);
+            if (!data)
+            {
+                Log("Lightmap %u could not be decompressed\n", i);
+                return false;
+            }
+            AddLightmapData(lmHeader.width, lmHeader.height, const_cast<unsigned char*>(data), lmHeader.dataSize,
+                    static_cast<ELightmapEncoding>(GetLightmapEncoding(lmHeader.compression)));
         }
+
+        m_lights.assign(view.GetLights(), view.GetLights() + view.GetLightCount());
+
         ValidateData();
-        fclose(fp);
         return true;
     }
 
@@ -218,19 +220,107 @@ namespace rade
     bool MeshFile::WriteToFile(const std::string& filename)
     {
         using namespace mesh;
-        FILE* fp = fopen(filename.c_str(), "wb");
-        if (!fp)
+        if (!ValidateData())
         {
             return false;
         }
 
-        if (!ValidateData())
+        // compress first, the section directory needs the sizes up front
+        std::vector<std::vector<unsigned char>> compressed(m_lightmaps.size());
+        std::atomic<bool> compressFailed{false};
+        std::atomic<uint64_t> squaredError{0};
+        ForEachLightmap(m_lightmaps.size(), [this, &compressed, &compressFailed, &squaredError](size_t i)
+        {
+            mesh::SLightmapHeader* lmHeader = m_lightmaps[i].GetHeaderPtr();
+            const unsigned char* rgba = m_lightmaps[i].GetLightmapData()->data;
+            uint8_t codec;
+            bool encoded;
+            if (m_lightmapStorage == ELightmapStorage_BC1 &&
+                GetLightmapEncoding(lmHeader->compression) == ELightmapEncoding_LDR)
+            {
+                uint64_t error = 0;
+                encoded = EncodeLightmapBC1(rgba, lmHeader->width, lmHeader->height, m_compressionLevel,
+                        m_bc1Quality, compressed[i], &codec, &error);
+                squaredError += error;
+            }
+            else
+            {
+                encoded = EncodeLightmap(rgba, lmHeader->width, lmHeader->height, m_compressionLevel,
+                        compressed[i], &codec);
+            }
+            if (!encoded)
+            {
+                Log("Failed to compress lightmap %u\n", static_cast<unsigned int>(i));
+                compressFailed = true;
+                return;
+            }
+            lmHeader->compression = static_cast<uint8_t>((lmHeader->compression & ~cLightmapCodecMask) | codec);
+            lmHeader->compressedDataSize = static_cast<uint32_t>(compressed[i].size());
+        });
+        if (compressFailed)
         {
             return false;
         }
 
-        // header
+        if (m_lightmapStorage == ELightmapStorage_BC1 && !m_lightmaps.empty())
+        {
+            size_t numSamples = 0;
+            for (LogicalLightmap& lm : m_lightmaps)
+            {
+                const SLightmapHeader* lmHeader = lm.GetHeaderPtr();
+                if ((lmHeader->compression & cLightmapCodecMask) == ELightmapCodec_BC1)
+                    numSamples += static_cast<size_t>(lmHeader->width) * lmHeader->height * 3;
+            }
+            if (numSamples > 0)
+                Log("Lightmaps stored as BC1, PSNR %.2f dB\n", GetPSNR(squaredError, numSamples));
+            else
+                Log("RGBM lightmaps need alpha, stored lossless instead of BC1\n");
+        }
+
+        SSection sections[ESection_Count] = {};
+        for (uint32_t i = 0; i < ESection_Count; i++)
+            sections[i].type = i;
+
+        for (LogicalMaterial& mat : m_materials)
+            sections[ESection_Materials].size += sizeof(SMaterialHeader) + mat.GetTextureKeys().size() * sizeof(STextureKey);
+        for (LogicalPolygon& poly : m_polygons)
+            sections[ESection_Faces].size += sizeof(SPolyHeader) + poly.GetPoints().size() * sizeof(SPolyPoint);
+        sections[ESection_LightmapIndex].size = m_lightmaps.size() * sizeof(uint64_t);
+        for (LogicalLightmap& lm : m_lightmaps)
+            sections[ESection_Lightmaps].size += sizeof(SLightmapHeader) + lm.GetHeaderPtr()->compressedDataSize;
+        sections[ESection_Lights].size = m_lights.size() * sizeof(SLight);
+
+        // sections follow the directory in ESection order
+        uint64_t offset = sizeof(SMeshHeader) + sizeof(SSectionDirectory) + sizeof(sections);
+        for (SSection& section : sections)
+        {
+            section.offset = offset;
+            offset += section.size;
+        }
+
+        std::vector<uint64_t> lightmapIndex;
+        lightmapIndex.reserve(m_lightmaps.size());
+        uint64_t lightmapOffset = sections[ESection_Lightmaps].offset;
+        for (LogicalLightmap& lm : m_lightmaps)
+        {
+            lightmapIndex.push_back(lightmapOffset);
+            lightmapOffset += sizeof(SLightmapHeader) + lm.GetHeaderPtr()->compressedDataSize;
+        }
+
+        FILE* fp = fopen(filename.c_str(), "wb");
+        if (!fp)
+        {
+            return false;
+        }
+
+        // header and section directory
+        m_header.version = MESH_VERSION_INDEXED;
         fwrite(&m_header, sizeof(SMeshHeader), 1, fp);
+        SSectionDirectory directory{};
+        directory.numSections = ESection_Count;
+        fwrite(&directory, sizeof(SSectionDirectory), 1, fp);
+        fwrite(sections, sizeof(sections), 1, fp);
+
         // materials
         for (LogicalMaterial& mat : m_materials)
         {
@@ -246,40 +336,24 @@ namespace rade
         for (LogicalPolygon& poly : m_polygons)
         {
             fwrite((mesh::SPolyHeader*)poly.GetHeaderPtr(), sizeof(mesh::SPolyHeader), 1, fp);
-            for (mesh::SPolyPoint& point : poly.GetPoints())
-            {
-                fwrite((mesh::SPolyPoint*)&point, sizeof(mesh::SPolyPoint), 1, fp);
-            }
+            fwrite(poly.GetPoints().data(), sizeof(mesh::SPolyPoint), poly.GetPoints().size(), fp);
         }
 
         // lightmaps
-        for (LogicalLightmap& lm : m_lightmaps)
+        fwrite(lightmapIndex.data(), sizeof(uint64_t), lightmapIndex.size(), fp);
+        for (size_t i = 0; i < m_lightmaps.size(); i++)
         {
-            mesh::SLightmap* lightmap = lm.GetLightmapData();
-
-            unsigned long compressedLen;
-            unsigned char* compressedBuffer = CreateCompressedBuffer(
-                    lightmap->data,
-                    lm.GetHeaderPtr()->dataSize,
-                    &compressedLen);
-
-            // write header with compressed info
-            lm.GetHeaderPtr()->compressedDataSize = compressedLen;
+            LogicalLightmap& lm = m_lightmaps[i];
             fwrite((mesh::SLightmapHeader*)lm.GetHeaderPtr(), sizeof(mesh::SLightmapHeader), 1, fp);
-
-            fwrite(compressedBuffer, compressedLen, 1, fp);
-
-            delete[] compressedBuffer;
+            fwrite(compressed[i].data(), lm.GetHeaderPtr()->compressedDataSize, 1, fp);
         }
 
-        for (mesh::SLight& light : m_lights)
-        {
-            fwrite((mesh::SLight*)&light, sizeof(mesh::SLight), 1, fp);
-        }
+        fwrite(m_lights.data(), sizeof(mesh::SLight), m_lights.size(), fp);
 
         fflush(fp);
+        bool written = !ferror(fp);
         fclose(fp);
-        return true;
+        return written;
     }
 
     bool MeshFile::ValidateData()
@@ -337,32 +411,16 @@ namespace rade
 
     void MeshFile::GetAsPolyList(std::vector<poly3d>& polyListOut)
     {
+        polyListOut.reserve(polyListOut.size() + m_polygons.size());
         for (LogicalPolygon& poly : m_polygons)
         {
-            poly3d newPoly;
-
-            uint16_t matIndex = poly.GetHeaderPtr()->matIndex;
+            uint32_t matIndex = poly.GetHeaderPtr()->matIndex;
+            std::string materialKey;
             if (m_materials.size() > matIndex)
             {
-                newPoly.SetMaterialKey(m_materials.at(matIndex).GetMaterialKey());
+                materialKey = m_materials.at(matIndex).GetMaterialKey();
             }
-
-            newPoly.SetLightmapDataIndex(poly.GetLightmapDataIndex());
-
-            for (const mesh::SPolyPoint& spoint : poly.GetPoints())
-            {
-                rade::vector3 p(spoint.point);
-                p.nx = spoint.nornmal[0];
-                p.ny = spoint.nornmal[1];
-                p.nz = spoint.nornmal[2];
-                p.u = spoint.uv0[0];
-                p.v = spoint.uv0[1];
-                p.lmU = spoint.uv1[0];
-                p.lmV = spoint.uv1[1];
-                newPoly.AddPoint(p);
-            }
-            newPoly.CalcNormal();
-            polyListOut.push_back(newPoly);
+            polyListOut.push_back(ToPoly3d(*poly.GetHeaderPtr(), poly.GetPoints().data(), materialKey));
         }
     }
 
@@ -370,10 +428,11 @@ namespace rade
             const uint16_t width,
             const uint16_t height,
             unsigned char* dataPtr,
-            const unsigned int dataSize)
+            const unsigned int dataSize,
+            const ELightmapEncoding encoding)
     {
         LogicalLightmap lightmap;
-        lightmap.AddLightmapData(width, height, dataPtr, dataSize);
+        lightmap.AddLightmapData(width, height, dataPtr, dataSize, encoding);
 
         m_lightmaps.push_back(lightmap);
         m_header.numLightmaps++;
@@ -386,6 +445,7 @@ namespace rade
             auto *newLM = new CLightmapImg(lm.GetHeaderPtr()->width, lm.GetHeaderPtr()->height);
             int bufferSize = newLM->m_width * newLM->m_height * 4;
             memcpy(newLM->m_data, lm.GetLightmapData()->data, bufferSize);
+            newLM->m_encoding = GetLightmapEncoding(lm.GetHeaderPtr()->compression);
             lmaps.push_back(newLM);
         }
     }
@@ -404,4 +464,279 @@ namespace rade
         m_lights.push_back(newLight);
         m_header.numLights = static_cast<uint32_t>(m_lights.size());
     }
+
+    bool MeshFileView::Open(const std::string& filename)
+    {
+        Close();
+        if (!m_file.Open(filename))
+        {
+            return false;
+        }
+
+        if (m_file.Size() < sizeof(mesh::SMeshHeader))
+        {
+            Log("%s is too small for an rbmesh header\n", filename.c_str());
+            Close();
+            return false;
+        }
+        m_header = At<mesh::SMeshHeader>(0);
+
+        // find where each record starts, nothing is copied
+        bool valid = m_header->version >= mesh::MESH_VERSION_INDEXED ? IndexSections() : IndexSequential();
+        if (!valid)
+        {
+            Log("%s is truncated or corrupt\n", filename.c_str());
+            Close();
+            return false;
+        }
+
+        m_lightmapCache.reset(new lightmapcache_t[m_lightmapOffsets.size()]);
+        return true;
+    }
+
+    bool MeshFileView::IndexMaterials(size_t offset, size_t end, size_t* next)
+    {
+        m_materialOffsets.reserve(m_header->numMaterials);
+        for (uint32_t i = 0; i < m_header->numMaterials; i++)
+        {
+            if (end - offset < sizeof(mesh::SMaterialHeader))
+                return false;
+
+            size_t size = sizeof(mesh::SMaterialHeader) +
+                    At<mesh::SMaterialHeader>(offset)->numTextureKeys * sizeof(mesh::STextureKey);
+            if (end - offset < size)
+                return false;
+
+            m_materialOffsets.push_back(offset);
+            offset += size;
+        }
+        *next = offset;
+        return true;
+    }
+
+    bool MeshFileView::IndexFaces(size_t offset, size_t end, size_t* next)
+    {
+        m_polyOffsets.reserve(m_header->numFaces);
+        for (uint32_t i = 0; i < m_header->numFaces; i++)
+        {
+            if (end - offset < sizeof(mesh::SPolyHeader))
+                return false;
+
+            uint64_t numPoints = At<mesh::SPolyHeader>(offset)->numPoints;
+            if ((end - offset - sizeof(mesh::SPolyHeader)) / sizeof(mesh::SPolyPoint) < numPoints)
+                return false;
+
+            m_polyOffsets.push_back(offset);
+            offset += sizeof(mesh::SPolyHeader) + numPoints * sizeof(mesh::SPolyPoint);
+        }
+        *next = offset;
+        return true;
+    }
+
+    bool MeshFileView::IndexSequential()
+    {
+        size_t fileSize = m_file.Size();
+        size_t offset = sizeof(mesh::SMeshHeader);
+
+        if (!IndexMaterials(offset, fileSize, &offset) || !IndexFaces(offset, fileSize, &offset))
+            return false;
+
+        m_lightmapOffsets.reserve(m_header->numLightmaps);
+        for (uint32_t i = 0; i < m_header->numLightmaps; i++)
+        {
+            if (fileSize - offset < sizeof(mesh::SLightmapHeader))
+                return false;
+
+            size_t size = sizeof(mesh::SLightmapHeader) + At<mesh::SLightmapHeader>(offset)->compressedDataSize;
+            if (fileSize - offset < size)
+                return false;
+
+            m_lightmapOffsets.push_back(offset);
+            offset += size;
+        }
+
+        m_lightmapsEnd = offset;
+        m_lightsOffset = offset;
+        return m_header->numLights <= (fileSize - offset) / sizeof(mesh::SLight);
+    }
+
+    bool MeshFileView::IndexSections()
+    {
+        size_t fileSize = m_file.Size();
+        size_t offset = sizeof(mesh::SMeshHeader);
+        if (fileSize - offset < sizeof(mesh::SSectionDirectory))
+            return false;
+
+        uint32_t numSections = At<mesh::SSectionDirectory>(offset)->numSections;
+        offset += sizeof(mesh::SSectionDirectory);
+        if ((fileSize - offset) / sizeof(mesh::SSection) < numSections)
+            return false;
+
+        const mesh::SSection* found[mesh::ESection_Count] = {};
+        const auto* sections = At<mesh::SSection>(offset);
+        for (uint32_t i = 0; i < numSections; i++)
+        {
+            const mesh::SSection& section = sections[i];
+            if (section.offset > fileSize || section.size > fileSize - section.offset)
+                return false;
+            if (section.type < mesh::ESection_Count)
+                found[section.type] = &section;
+        }
+        for (const mesh::SSection* section : found)
+        {
+            if (!section)
+                return false;
+        }
+
+        const mesh::SSection& materials = *found[mesh::ESection_Materials];
+        const mesh::SSection& faces = *found[mesh::ESection_Faces];
+        size_t next;
+        if (!IndexMaterials(materials.offset, materials.offset + materials.size, &next) ||
+            !IndexFaces(faces.offset, faces.offset + faces.size, &next))
+            return false;
+
+        // lightmap headers are only read when the lightmap is, GetLightmapData() checks them
+        // against the end of the section
+        const mesh::SSection& lightmapIndex = *found[mesh::ESection_LightmapIndex];
+        const mesh::SSection& lightmaps = *found[mesh::ESection_Lightmaps];
+        if (lightmapIndex.size / sizeof(uint64_t) < m_header->numLightmaps)
+            return false;
+
+        // the file is packed, so the offsets are copied out rather than read in place
+        const auto* lightmapOffsets = At<unsigned char>(lightmapIndex.offset);
+        m_lightmapOffsets.reserve(m_header->numLightmaps);
+        for (uint32_t i = 0; i < m_header->numLightmaps; i++)
+        {
+            uint64_t lmOffset;
+            memcpy(&lmOffset, lightmapOffsets + i * sizeof(uint64_t), sizeof(uint64_t));
+            if (lmOffset < lightmaps.offset || lmOffset > lightmaps.offset + lightmaps.size ||
+                lightmaps.offset + lightmaps.size - lmOffset < sizeof(mesh::SLightmapHeader))
+                return false;
+            m_lightmapOffsets.push_back(lmOffset);
+        }
+        m_lightmapsEnd = lightmaps.offset + lightmaps.size;
+
+        const mesh::SSection& lights = *found[mesh::ESection_Lights];
+        m_lightsOffset = lights.offset;
+        return m_header->numLights <= lights.size / sizeof(mesh::SLight);
+    }
+
+    void MeshFileView::Close()
+    {
+        m_lightmapCache.reset();
+        m_materialOffsets.clear();
+        m_polyOffsets.clear();
+        m_lightmapOffsets.clear();
+        m_lightmapsEnd = 0;
+        m_lightsOffset = 0;
+        m_header = nullptr;
+        m_file.Close();
+    }
+
+    const unsigned char* MeshFileView::GetLightmapData(uint32_t index)
+    {
+        lightmapcache_t& cache = m_lightmapCache[index];
+        std::call_once(cache.decoded, [this, index, &cache]()
+        {
+            const mesh::SLightmapHeader& lmHeader = GetLightmapHeader(index);
+            const unsigned char* payload = GetLightmapPayload(index);
+            if (!payload || lmHeader.dataSize < static_cast<uint32_t>(lmHeader.width) * lmHeader.height * 4)
+            {
+                return;
+            }
+
+            std::unique_ptr<unsigned char[]> data(new unsigned char[lmHeader.dataSize]);
+            if (DecodeLightmap(lmHeader.compression, payload, lmHeader.compressedDataSize,
+                    lmHeader.width, lmHeader.height, data.get()))
+            {
+                cache.data = std::move(data);
+            }
+        });
+        return cache.data.get();
+    }
+
+    void MeshFileView::GetAsPolyList(std::vector<poly3d>& polyListOut) const
+    {
+        // material names once, not per poly
+        std::vector<std::string> materialKeys(GetMaterialCount());
+        for (uint32_t i = 0; i < GetMaterialCount(); i++)
+        {
+            const char* name = GetMaterialHeader(i).materialName;
+            materialKeys[i] = std::string(name, strnlen(name, mesh::MATERIAL_NAME_LEN));
+        }
+
+        static const std::string noMaterial;
+        polyListOut.reserve(polyListOut.size() + GetPolyCount());
+        for (uint32_t i = 0; i < GetPolyCount(); i++)
+        {
+            const mesh::SPolyHeader& header = GetPolyHeader(i);
+            const std::string& materialKey = header.matIndex < materialKeys.size() ? materialKeys[header.matIndex] : noMaterial;
+            polyListOut.push_back(ToPoly3d(header, GetPolyPoints(i), materialKey));
+        }
+    }
+
+    bool MeshFileView::GetLightmapBlocks(uint32_t index, std::vector<unsigned char>& blocks) const
+    {
+        const mesh::SLightmapHeader& lmHeader = GetLightmapHeader(index);
+        const unsigned char* payload = GetLightmapPayload(index);
+        if (!payload || (lmHeader.compression & cLightmapCodecMask) != ELightmapCodec_BC1)
+        {
+            return false;
+        }
+
+        blocks.resize(GetBC1Size(lmHeader.width, lmHeader.height));
+        if (!DecodeLightmapBlocks(lmHeader.compression, payload, lmHeader.compressedDataSize,
+                lmHeader.width, lmHeader.height, blocks.data()))
+        {
+            blocks.clear();
+            return false;
+        }
+        return true;
+    }
+
+    const unsigned char* MeshFileView::GetLightmapPayload(uint32_t index) const
+    {
+        const mesh::SLightmapHeader& lmHeader = GetLightmapHeader(index);
+        size_t payloadOffset = m_lightmapOffsets[index] + sizeof(mesh::SLightmapHeader);
+        if (m_lightmapsEnd - payloadOffset < lmHeader.compressedDataSize)
+        {
+            return nullptr;
+        }
+        return At<unsigned char>(payloadOffset);
+    }
+
+    void MeshFileView::GetLightMaps(std::vector<CLightmapImg*>& lmaps)
+    {
+        size_t first = lmaps.size();
+        for (uint32_t i = 0; i < GetLightmapCount(); i++)
+        {
+            const mesh::SLightmapHeader& lmHeader = GetLightmapHeader(i);
+            auto* newLM = new CLightmapImg(lmHeader.width, lmHeader.height);
+            newLM->m_encoding = GetLightmapEncoding(lmHeader.compression);
+            lmaps.push_back(newLM);
+        }
+
+        ForEachLightmap(GetLightmapCount(), [this, &lmaps, first](size_t i)
+        {
+            CLightmapImg* newLM = lmaps[first + i];
+            auto index = static_cast<uint32_t>(i);
+            if (GetLightmapBlocks(index, newLM->m_bc1Blocks))
+            {
+                // keep the blocks for a compressed upload, the lumels are decoded from them
+                DecodeBC1(newLM->m_bc1Blocks.data(), newLM->m_width, newLM->m_height, newLM->m_data);
+                return;
+            }
+
+            const unsigned char* data = GetLightmapData(index);
+            if (data)
+            {
+                memcpy(newLM->m_data, data, newLM->m_width * newLM->m_height * 4);
+            }
+            else
+            {
+                // keep the indexes lined up, the lightmap stays black
+                Log("Lightmap %u could not be decompressed\n", static_cast<unsigned int>(i));
+            }
+        });
+    }
 };
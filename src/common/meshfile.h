@@ -3,9 +3,13 @@
 #include <vector>
 #include <cstring>
 #include <algorithm>
+#include <memory>
+#include <mutex>
 #include "lightmapgen.h"
 #include "lightmapimage.h"
 #include "polygon3d.h"
+#include "osutils.h"
+#include "lightmapcodec.h"
 
 namespace rade
 {
@@ -13,6 +17,21 @@ namespace rade
     {
         const int MATERIAL_NAME_LEN = 16;
 
+        // SMeshHeader.version. Versions before 2 are one sequential stream of materials, faces,
+        // lightmaps and lights. Version 2 follows the header with a section directory so a reader
+        // can seek straight to any section or to a single lightmap
+        const uint8_t MESH_VERSION_INDEXED = 2;
+
+        enum ESection
+        {
+            ESection_Materials = 0,
+            ESection_Faces,
+            ESection_LightmapIndex,     // one uint64_t file offset per lightmap
+            ESection_Lightmaps,
+            ESection_Lights,
+            ESection_Count
+        };
+
         // no auto byte alignment (these structs are written to file)
 #pragma pack(push, 1)
         typedef struct
@@ -66,7 +85,7 @@ namespace rade
 
         typedef struct
         {
-            uint8_t compression;
+            uint8_t compression;        // ELightmapCodec
             uint16_t width;
             uint16_t height;
             uint32_t dataSize;
@@ -78,6 +97,20 @@ namespace rade
             unsigned char* data;
         } SLightmap;
 
+        // version 2, straight after SMeshHeader and followed by numSections SSection records.
+        // Readers skip section types they do not know
+        typedef struct
+        {
+            uint32_t numSections;
+        } SSectionDirectory;
+
+        typedef struct
+        {
+            uint32_t type;      // ESection
+            uint64_t offset;    // from the start of the file
+            uint64_t size;
+        } SSection;
+
 #pragma pack(pop)
     }; // namespace mesh
 
@@ -109,6 +142,12 @@ namespace rade
             polyHeader.numPoints++;
         }
 
+        void SetPoints(const mesh::SPolyPoint* pointList, uint32_t numPoints)
+        {
+            points.assign(pointList, pointList + numPoints);
+            polyHeader.numPoints = numPoints;
+        }
+
         mesh::SPolyHeader* GetHeaderPtr()
         {
             return &polyHeader;
@@ -174,11 +213,12 @@ namespace rade
 
         void
         AddLightmapData(const uint16_t width, const uint16_t height, unsigned char* dataPtr,
-                const unsigned int dataSize)
+                const unsigned int dataSize, ELightmapEncoding encoding = ELightmapEncoding_LDR)
         {
             lmHeader.width = width;
             lmHeader.height = height;
             lmHeader.dataSize = dataSize;
+            lmHeader.compression = static_cast<uint8_t>(encoding << cLightmapEncodingShift);
             lmData.data = new unsigned char[width * height * 4];
             memcpy(lmData.data, dataPtr, width * height * 4);
         }
@@ -217,13 +257,28 @@ namespace rade
 
         bool WriteToFile(const std::string& filename);
 
+        // deflate level for the lightmaps WriteToFile() stores, 0 to cMaxLightmapCompressionLevel
+        void SetCompressionLevel(int level)
+        {
+            m_compressionLevel = level;
+        }
+
+        // ELightmapStorage_BC1 trades exact lumels for GPU ready blocks, WriteToFile() logs the PSNR.
+        // BC1 has no alpha, so RGBM lightmaps are always stored lossless
+        void SetLightmapStorage(ELightmapStorage storage, EBC1Quality quality = EBC1Quality_Normal)
+        {
+            m_lightmapStorage = storage;
+            m_bc1Quality = quality;
+        }
+
         void GetAsPolyList(std::vector<poly3d>& polyListOut);
 
         void AddLightmapData(
                 uint16_t width,
                 uint16_t height,
                 unsigned char* dataPtr,
-                unsigned int dataSize);
+                unsigned int dataSize,
+                ELightmapEncoding encoding = ELightmapEncoding_LDR);
 
         void GetLightMaps(std::vector<CLightmapImg*>& lmaps);
 
@@ -243,15 +298,6 @@ namespace rade
 
     protected:
 
-        unsigned char* CreateCompressedBuffer(
-                unsigned char* pData,
-                unsigned long nDataSize,
-                unsigned long* nCompressedDataSize);
-
-        unsigned char* CreateUncompressedBuffer(unsigned char* pCompressedData,
-                unsigned long nCompressedDataSize,
-                unsigned long nOriginalDataSize);
-
         void FreeAll();
 
         void Reset();
@@ -267,6 +313,124 @@ namespace rade
         std::vector<LogicalPolygon> m_polygons;
         std::vector<LogicalLightmap> m_lightmaps;
         std::vector<mesh::SLight> m_lights;
+        int m_compressionLevel = cDefaultLightmapCompressionLevel;
+        ELightmapStorage m_lightmapStorage = ELightmapStorage_Lossless;
+        EBC1Quality m_bc1Quality = EBC1Quality_Normal;
+
+    };
+
+    // read-only access to an rbmesh file without copying it. The file is memory mapped and the
+    // packed records are returned in place, lightmaps are only decompressed when first asked for
+    class MeshFileView
+    {
+    public:
+
+        bool Open(const std::string& filename);
+
+        void Close();
+
+        const mesh::SMeshHeader& GetHeader() const
+        {
+            return *m_header;
+        }
+
+        uint32_t GetMaterialCount() const
+        {
+            return static_cast<uint32_t>(m_materialOffsets.size());
+        }
+
+        const mesh::SMaterialHeader& GetMaterialHeader(uint32_t index) const
+        {
+            return *At<mesh::SMaterialHeader>(m_materialOffsets[index]);
+        }
+
+        // GetMaterialHeader(index).numTextureKeys records
+        const mesh::STextureKey* GetTextureKeys(uint32_t index) const
+        {
+            return At<mesh::STextureKey>(m_materialOffsets[index] + sizeof(mesh::SMaterialHeader));
+        }
 
+        uint32_t GetPolyCount() const
+        {
+            return static_cast<uint32_t>(m_polyOffsets.size());
+        }
+
+        const mesh::SPolyHeader& GetPolyHeader(uint32_t index) const
+        {
+            return *At<mesh::SPolyHeader>(m_polyOffsets[index]);
+        }
+
+        // GetPolyHeader(index).numPoints records
+        const mesh::SPolyPoint* GetPolyPoints(uint32_t index) const
+        {
+            return At<mesh::SPolyPoint>(m_polyOffsets[index] + sizeof(mesh::SPolyHeader));
+        }
+
+        uint32_t GetLightmapCount() const
+        {
+            return static_cast<uint32_t>(m_lightmapOffsets.size());
+        }
+
+        const mesh::SLightmapHeader& GetLightmapHeader(uint32_t index) const
+        {
+            return *At<mesh::SLightmapHeader>(m_lightmapOffsets[index]);
+        }
+
+        // RGBA lumels, decompressed on first use and kept until Close(). Safe to call from several
+        // threads, returns nullptr if the payload is corrupt
+        const unsigned char* GetLightmapData(uint32_t index);
+
+        // the BC1 blocks of an ELightmapCodec_BC1 lightmap, false for the lossless codecs
+        bool GetLightmapBlocks(uint32_t index, std::vector<unsigned char>& blocks) const;
+
+        uint32_t GetLightCount() const
+        {
+            return m_header ? m_header->numLights : 0;
+        }
+
+        const mesh::SLight* GetLights() const
+        {
+            return At<mesh::SLight>(m_lightsOffset);
+        }
+
+        void GetAsPolyList(std::vector<poly3d>& polyListOut) const;
+
+        void GetLightMaps(std::vector<CLightmapImg*>& lmaps);
+
+    private:
+
+        typedef struct
+        {
+            std::once_flag decoded;
+            std::unique_ptr<unsigned char[]> data;
+        } lightmapcache_t;
+
+        MappedFile m_file;
+        const mesh::SMeshHeader* m_header = nullptr;
+        std::vector<size_t> m_materialOffsets;
+        std::vector<size_t> m_polyOffsets;
+        std::vector<size_t> m_lightmapOffsets;
+        size_t m_lightmapsEnd = 0;
+        size_t m_lightsOffset = 0;
+        std::unique_ptr<lightmapcache_t[]> m_lightmapCache;
+
+        // versions before 2, walks every record
+        bool IndexSequential();
+
+        // version 2, only the materials and faces are walked, lightmaps come from the index
+        bool IndexSections();
+
+        bool IndexMaterials(size_t offset, size_t end, size_t* next);
+
+        bool IndexFaces(size_t offset, size_t end, size_t* next);
+
+        // nullptr when the payload runs past the lightmaps section
+        const unsigned char* GetLightmapPayload(uint32_t index) const;
+
+        template<typename T>
+        const T* At(size_t offset) const
+        {
+            return reinterpret_cast<const T*>(m_file.Data() + offset);
+        }
     };
 };
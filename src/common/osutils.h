@@ -61,6 +61,40 @@ namespace rade
     double GetTimerFrequency(); // frequency based on the timer in use by platform
 
     void GenerateGUID(unsigned char* out_bytes);
+
+    // read-only view of a whole file, memory mapped so nothing is read until it is touched
+    class MappedFile
+    {
+    public:
+        MappedFile() = default;
+
+        ~MappedFile();
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        bool Open(const std::string& filename);
+
+        void Close();
+
+        const unsigned char* Data() const
+        {
+            return m_data;
+        }
+
+        size_t Size() const
+        {
+            return m_size;
+        }
+
+    private:
+        const unsigned char* m_data = nullptr;
+        size_t m_size = 0;
+#ifdef _WIN32
+        void* m_fileHandle = nullptr;
+        void* m_mappingHandle = nullptr;
+#endif
+    };
 #ifdef __ANDROID__
     static long GetAssetData(const char* filename, void** outData);
     extern struct android_app*  g_App;
@@ -101,7 +101,7 @@ namespace rade
 
         rade::math::ESide ClassifyPolygon(const poly3d& poly);
 
-        std::string GetMaterialKey() const
+        const std::string& GetMaterialKey() const
         {
             return m_materialKey;
         }
@@ -116,7 +116,7 @@ namespace rade
             m_shaderKey = shaderKey;
         }
 
-        std::string GetShaderKey()
+        const std::string& GetShaderKey() const
         {
             return m_shaderKey;
         }
@@ -3,6 +3,7 @@
 #include "material.h"
 #include "materialmanager.h"
 #include "display_gl.h"
+#include "lightmapcodec.h"
 
 namespace rade
 {
@@ -64,15 +65,46 @@ namespace rade
             RMaterials::ETextureFilterMode filterMode = RMaterials::TEXTURE_FILTER_MIPMAPLINEAR; //RMaterials::TEXTURE_FILTER_LINEAR;
             RMaterials::ETextureClampMode clampMode = RMaterials::TEXTURE_REPEAT_CLAMP_TO_EDGE;
 
-            bool loaded = materialMgr.LoadRAWTextureData(
-                    lm->m_data,
-                    lm->m_width,
-                    lm->m_height,
-                    4, // TODO: this should be reduced to 3
-                    genMipMaps,
-                    filterMode,
-                    clampMode,
-                    &texID);
+            // BC1 lightmaps go up as they are stored, an eighth of the RGBA size. Without driver
+            // support they fall back to the decoded lumels
+            unsigned int channels = 4;
+            bool loaded = false;
+            if (!lm->m_bc1Blocks.empty())
+            {
+                loaded = materialMgr.LoadBC1TextureData(
+                        lm->m_bc1Blocks.data(),
+                        static_cast<unsigned int>(lm->m_bc1Blocks.size()),
+                        lm->m_width,
+                        lm->m_height,
+                        clampMode,
+                        &texID);
+                if (loaded)
+                    channels = 3;
+            }
+
+            // HDR lightmaps are tonemapped down to RGBA8 here, the shaders only see display colour
+            std::vector<unsigned char> toneMapped;
+            const unsigned char* lumels = lm->m_data;
+            if (!loaded && lm->m_encoding == ELightmapEncoding_RGBM)
+            {
+                size_t numLumels = static_cast<size_t>(lm->m_width) * lm->m_height;
+                toneMapped.resize(numLumels * 4);
+                ToneMapRGBM(lm->m_data, numLumels, m_lightmapExposure, toneMapped.data());
+                lumels = toneMapped.data();
+            }
+
+            if (!loaded)
+            {
+                loaded = materialMgr.LoadRAWTextureData(
+                        lumels,
+                        lm->m_width,
+                        lm->m_height,
+                        4, // TODO: this should be reduced to 3
+                        genMipMaps,
+                        filterMode,
+                        clampMode,
+                        &texID);
+            }
             if (!loaded)
             {
                 texID = 0;
@@ -81,7 +113,7 @@ namespace rade
 
             lmInfo.width = lm->m_width;
             lmInfo.height = lm->m_height;
-            lmInfo.channels = 4;
+            lmInfo.channels = channels;
             lmInfo.texID = texID;
 
             m_lightmaps.push_back(lmInfo);
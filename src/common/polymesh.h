@@ -37,6 +37,13 @@ namespace rade
 
         void LoadLightmaps(CMaterialManager& materialMgr, std::vector<CLightmapImg*>& lightmaps);
 
+        // scale for HDR (RGBM) lightmaps before they are tonemapped, applies from the next
+        // LoadLightmaps()
+        void SetLightmapExposure(float exposure)
+        {
+            m_lightmapExposure = exposure;
+        }
+
         bool HasLightmaps() const
         {
             return m_hasLightmaps;
@@ -64,6 +71,7 @@ namespace rade
         std::vector<rade::poly3d> m_polyList;
         std::vector<lightmapInfo_t> m_lightmaps;
         bool m_hasLightmaps = false;
+        float m_lightmapExposure = 1.0f;
 
         //CDisplayGL* m_display = nullptr;
 
@@ -0,0 +1,163 @@
+#include <algorithm>
+#include <cmath>
+#include <utility>
+#include "sampler.h"
+#include "rmath.h"
+
+namespace rade
+{
+    Random::Random(uint64_t seed, uint64_t stream)
+    {
+        Seed(seed, stream);
+    }
+
+    void Random::Seed(uint64_t seed, uint64_t stream)
+    {
+        // standard PCG32 initialisation
+        m_state = 0;
+        m_inc = (stream << 1u) | 1u;
+        NextUInt();
+        m_state += seed;
+        NextUInt();
+    }
+
+    uint32_t Random::NextUInt()
+    {
+        uint64_t oldState = m_state;
+        m_state = oldState * 6364136223846793005ULL + m_inc;
+        uint32_t xorShifted = static_cast<uint32_t>(((oldState >> 18u) ^ oldState) >> 27u);
+        uint32_t rot = static_cast<uint32_t>(oldState >> 59u);
+        return (xorShifted >> rot) | (xorShifted << ((32 - rot) & 31));
+    }
+
+    float Random::NextFloat()
+    {
+        // 24 bits so the result is exactly representable and never rounds up to 1
+        return static_cast<float>(NextUInt() >> 8) * (1.0f / 16777216.0f);
+    }
+
+    namespace sampling
+    {
+        float RadicalInverse(uint32_t bits)
+        {
+            bits = (bits << 16u) | (bits >> 16u);
+            bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+            bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+            bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+            bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+            return static_cast<float>(bits >> 8) * (1.0f / 16777216.0f);
+        }
+
+        void Hammersley(uint32_t i, uint32_t n, float* u, float* v)
+        {
+            *u = (static_cast<float>(i) + 0.5f) / static_cast<float>(n);
+            *v = RadicalInverse(i);
+        }
+
+        float3 CosineHemisphere(const float3& normal, float u, float v)
+        {
+            // orthonormal basis around the normal
+            float3 n = normal;
+            n.Normalize();
+            float3 axis = std::fabs(n.x) > 0.9f ? float3(0.0f, 1.0f, 0.0f) : float3(1.0f, 0.0f, 0.0f);
+            float3 tangent = axis.CrossProduct(n);
+            tangent.Normalize();
+            float3 bitangent = n.CrossProduct(tangent);
+
+            // uniform point on the unit disc projected up onto the hemisphere
+            float r = sqrtf(u);
+            float phi = math::c2Pi * v;
+            float x = r * cosf(phi);
+            float y = r * sinf(phi);
+            float z = sqrtf(std::max(0.0f, 1.0f - u));
+
+            float3 dir = tangent * x + bitangent * y + n * z;
+            dir.Normalize();
+            return dir;
+        }
+
+        void GenerateHemisphere(
+                const float3& normal,
+                int numSamples,
+                ESampleMode mode,
+                Random& random,
+                std::vector<float3>& outDirs)
+        {
+            outDirs.clear();
+            if (numSamples <= 0)
+                return;
+            outDirs.reserve(numSamples);
+
+            switch (mode)
+            {
+            case ESampleMode_Random:
+                while (static_cast<int>(outDirs.size()) < numSamples)
+                {
+                    float3 p(random.NextFloat(-1, 1), random.NextFloat(-1, 1), random.NextFloat(-1, 1));
+
+                    // reject ones outside unit sphere and "down" dirs (below the surface)
+                    if (p.x * p.x + p.y * p.y + p.z * p.z > 0.9999f) continue;
+                    if (p.Dot(normal) < 0.001f) continue;
+
+                    p.Normalize();
+                    outDirs.push_back(p);
+                }
+                break;
+
+            case ESampleMode_Stratified:
+            {
+                // one sample per stratum on each axis, v strata shuffled against u
+                std::vector<uint32_t> order(numSamples);
+                for (int i = 0; i < numSamples; i++)
+                    order[i] = static_cast<uint32_t>(i);
+                for (int i = numSamples - 1; i > 0; i--)
+                    std::swap(order[i], order[random.NextUInt() % static_cast<uint32_t>(i + 1)]);
+
+                for (int i = 0; i < numSamples; i++)
+                {
+                    float u = (static_cast<float>(i) + random.NextFloat()) / static_cast<float>(numSamples);
+                    float v = (static_cast<float>(order[i]) + random.NextFloat()) / static_cast<float>(numSamples);
+                    outDirs.push_back(CosineHemisphere(normal, u, v));
+                }
+                break;
+            }
+
+            case ESampleMode_Hammersley:
+            default:
+            {
+                // random rotation of the set so different normals do not share one pattern
+                float offsetU = random.NextFloat();
+                float offsetV = random.NextFloat();
+                for (int i = 0; i < numSamples; i++)
+                {
+                    float u, v;
+                    Hammersley(static_cast<uint32_t>(i), static_cast<uint32_t>(numSamples), &u, &v);
+                    u += offsetU;
+                    v += offsetV;
+                    if (u >= 1.0f) u -= 1.0f;
+                    if (v >= 1.0f) v -= 1.0f;
+                    outDirs.push_back(CosineHemisphere(normal, u, v));
+                }
+                break;
+            }
+            }
+        }
+
+        uint64_t HashSeed(uint64_t seed, const int32_t* values, int numValues)
+        {
+            // splitmix64 over the seed and each value
+            uint64_t h = seed;
+            for (int i = 0; i <= numValues; i++)
+            {
+                if (i > 0)
+                    h ^= static_cast<uint64_t>(static_cast<uint32_t>(values[i - 1]));
+                h += 0x9E3779B97F4A7C15ULL;
+                uint64_t z = h;
+                z = (z ^ (z >> 30u)) * 0xBF58476D1CE4E5B9ULL;
+                z = (z ^ (z >> 27u)) * 0x94D049BB133111EBULL;
+                h = z ^ (z >> 31u);
+            }
+            return h;
+        }
+    }
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "float3.h"
+
+namespace rade
+{
+    // PCG32 generator with its own state, so each thread or task can own one instead of sharing
+    // the global rand(). The same seed and stream always give the same sequence
+    class Random
+    {
+    public:
+
+        explicit Random(uint64_t seed = 0, uint64_t stream = 0);
+
+        void Seed(uint64_t seed, uint64_t stream = 0);
+
+        uint32_t NextUInt();
+
+        // uniform in [0, 1)
+        float NextFloat();
+
+        // uniform in [a, b)
+        float NextFloat(float a, float b)
+        {
+            return a + (b - a) * NextFloat();
+        }
+
+    private:
+        uint64_t m_state = 0;
+        uint64_t m_inc = 1;
+    };
+
+    namespace sampling
+    {
+        enum ESampleMode
+        {
+            ESampleMode_Random = 0,     // uniform hemisphere by rejection, as the original AO
+            ESampleMode_Stratified,     // jittered latin hypercube, cosine weighted
+            ESampleMode_Hammersley      // rotated Hammersley set, cosine weighted
+        };
+
+        // van der Corput radical inverse in base 2
+        float RadicalInverse(uint32_t bits);
+
+        // point i of an n point Hammersley set in [0, 1)^2
+        void Hammersley(uint32_t i, uint32_t n, float* u, float* v);
+
+        // maps (u, v) in [0, 1)^2 to a cosine weighted unit direction around normal
+        float3 CosineHemisphere(const float3& normal, float u, float v);
+
+        // numSamples unit directions in the hemisphere above normal
+        void GenerateHemisphere(
+                const float3& normal,
+                int numSamples,
+                ESampleMode mode,
+                Random& random,
+                std::vector<float3>& outDirs);
+
+        // hash of a few integers, for seeding a generator from a key
+        uint64_t HashSeed(uint64_t seed, const int32_t* values, int numValues);
+    }
+}
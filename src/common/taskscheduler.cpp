@@ -0,0 +1,143 @@
+#include "taskscheduler.h"
+
+namespace
+{
+    // the scheduler and worker index of the current thread
+    thread_local const rade::TaskScheduler* t_scheduler = nullptr;
+    thread_local int t_workerIndex = -1;
+}
+
+namespace rade
+{
+    TaskScheduler::TaskScheduler(unsigned int numThreads)
+    {
+        if (numThreads == 0)
+            numThreads = std::thread::hardware_concurrency();
+        if (numThreads == 0)
+            numThreads = 1;
+
+        for (unsigned int i = 0; i < numThreads; i++)
+            m_workers.emplace_back(new worker_t);
+
+        // all deques exist before any worker starts stealing
+        for (unsigned int i = 0; i < numThreads; i++)
+            m_threads.emplace_back(&TaskScheduler::WorkerLoop, this, i);
+    }
+
+    TaskScheduler::~TaskScheduler()
+    {
+        Wait();
+        {
+            std::lock_guard<std::mutex> lock(m_sleepMutex);
+            m_quit = true;
+        }
+        m_workCv.notify_all();
+
+        for (std::thread& t : m_threads)
+        {
+            if (t.joinable())
+                t.join();
+        }
+    }
+
+    int TaskScheduler::CurrentWorker() const
+    {
+        return t_scheduler == this ? t_workerIndex : -1;
+    }
+
+    void TaskScheduler::Submit(task_t task)
+    {
+        int index = CurrentWorker();
+        if (index < 0)
+            index = static_cast<int>(m_nextWorker++ % m_workers.size());
+
+        // counted before the push so a worker can never take the count below zero
+        m_pending++;
+        m_queued++;
+        {
+            worker_t& worker = *m_workers[index];
+            std::lock_guard<std::mutex> lock(worker.mutex);
+            worker.tasks.push_back(std::move(task));
+        }
+
+        // taking the lock orders this with a worker checking m_queued before it sleeps
+        {
+            std::lock_guard<std::mutex> lock(m_sleepMutex);
+        }
+        m_workCv.notify_one();
+    }
+
+    void TaskScheduler::Wait()
+    {
+        std::unique_lock<std::mutex> lock(m_doneMutex);
+        m_doneCv.wait(lock, [this] { return m_pending == 0; });
+    }
+
+    void TaskScheduler::ParallelFor(size_t count, const std::function<void(size_t)>& fn)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            Submit([&fn, i] { fn(i); });
+        }
+        Wait();
+    }
+
+    bool TaskScheduler::PopTask(unsigned int index, task_t& task)
+    {
+        // newest first, it is the most likely to still be in cache
+        worker_t& worker = *m_workers[index];
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        if (worker.tasks.empty())
+            return false;
+
+        task = std::move(worker.tasks.back());
+        worker.tasks.pop_back();
+        return true;
+    }
+
+    bool TaskScheduler::StealTask(unsigned int index, task_t& task)
+    {
+        size_t numWorkers = m_workers.size();
+        for (size_t i = 1; i < numWorkers; i++)
+        {
+            worker_t& victim = *m_workers[(index + i) % numWorkers];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (victim.tasks.empty())
+                continue;
+
+            // oldest first, the opposite end to the owner
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            return true;
+        }
+        return false;
+    }
+
+    void TaskScheduler::WorkerLoop(unsigned int index)
+    {
+        t_scheduler = this;
+        t_workerIndex = static_cast<int>(index);
+
+        while (true)
+        {
+            task_t task;
+            if (PopTask(index, task) || StealTask(index, task))
+            {
+                m_queued--;
+                task();
+
+                if (--m_pending == 0)
+                {
+                    std::lock_guard<std::mutex> lock(m_doneMutex);
+                    m_doneCv.notify_all();
+                }
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(m_sleepMutex);
+            m_workCv.wait(lock, [this] { return m_quit || m_queued > 0; });
+            if (m_quit)
+                return;
+        }
+    }
+}
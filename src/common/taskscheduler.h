@@ -0,0 +1,76 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace rade
+{
+    // fixed pool of worker threads with a task deque per worker. A worker takes its own newest task
+    // first and steals the oldest task of another worker when it runs dry, so uneven task costs
+    // still keep every thread busy
+    class TaskScheduler
+    {
+    public:
+
+        typedef std::function<void()> task_t;
+
+        // numThreads 0 uses one worker per hardware thread
+        explicit TaskScheduler(unsigned int numThreads = 0);
+
+        ~TaskScheduler();
+
+        unsigned int NumThreads() const
+        {
+            return static_cast<unsigned int>(m_workers.size());
+        }
+
+        // queue a task. Called from a worker it goes on that worker's deque, otherwise the
+        // deques are filled round robin
+        void Submit(task_t task);
+
+        // block until every submitted task, including tasks queued by other tasks, has run
+        void Wait();
+
+        // run fn(i) for every i in [0, count) across the workers and wait for them all. Not for
+        // use from inside a task, Wait() would block the worker
+        void ParallelFor(size_t count, const std::function<void(size_t)>& fn);
+
+        // index of the calling worker thread of this scheduler, -1 for any other thread
+        int CurrentWorker() const;
+
+    private:
+
+        typedef struct
+        {
+            std::mutex mutex;
+            std::deque<task_t> tasks;
+        } worker_t;
+
+        std::vector<std::unique_ptr<worker_t>> m_workers;
+        std::vector<std::thread> m_threads;
+
+        // tasks submitted but not finished, and tasks still sitting in a deque
+        std::atomic<uint32_t> m_pending{0};
+        std::atomic<uint32_t> m_queued{0};
+        std::atomic<uint32_t> m_nextWorker{0};
+        bool m_quit = false;
+
+        std::mutex m_sleepMutex;
+        std::condition_variable m_workCv;
+
+        std::mutex m_doneMutex;
+        std::condition_variable m_doneCv;
+
+        void WorkerLoop(unsigned int index);
+
+        bool PopTask(unsigned int index, task_t& task);
+
+        bool StealTask(unsigned int index, task_t& task);
+    };
+}
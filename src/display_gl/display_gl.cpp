@@ -4,6 +4,12 @@
 #include "material.h"
 
 #include <glad/glad.h>
+#include <cstring>
+
+// EXT_texture_compression_s3tc, not part of core GL so not in the glad header
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
 
 using namespace rade;
 
@@ -32,6 +38,8 @@ CDisplayGL::~CDisplayGL()
         delete mesh.second;
     }
     m_meshes.clear();
+
+    m_renderState.Shutdown();
 }
 
 bool CDisplayGL::Init(int screenWidth, int screenHeight)
@@ -47,6 +55,16 @@ bool CDisplayGL::Init(int screenWidth, int screenHeight)
     glGetIntegerv(GL_MAX_TEXTURE_SIZE, &m_maxTextureSize);
     glGetIntegerv(GL_MAX_TEXTURE_IMAGE_UNITS, &m_maxTextureUnits);
 
+    GLint numExtensions = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &numExtensions);
+    for (GLint i = 0; i < numExtensions; i++)
+    {
+        const char* ext = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i));
+        if (ext && strcmp(ext, "GL_EXT_texture_compression_s3tc") == 0)
+            m_hasS3TC = true;
+    }
+    Log("S3TC texture compression: %s\n", m_hasS3TC ? "yes" : "no");
+
     SetViewport(screenWidth, screenHeight);
 
     glEnable(GL_DEPTH_TEST);
@@ -58,6 +76,8 @@ bool CDisplayGL::Init(int screenWidth, int screenHeight)
     glEnable(GL_BLEND);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
+    m_renderState.Init();
+
     m_noTexture = m_materialMgr.LoadFromKey("notexture");
     if (!m_noTexture)
     {
@@ -99,6 +119,9 @@ void CDisplayGL::Draw(double deltaTime)
     glClearColor(0.06f, 0.06f, 0.06f, 1.0f);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
+    // imgui and texture uploads since the last frame have changed the bindings
+    m_renderState.Invalidate();
+
     DrawDebug();
 }
 
@@ -116,6 +139,66 @@ bool CDisplayGL::LoadRAWTextureData(const unsigned char* data,
         const RMaterials::ETextureFilterMode minMagFiler,
         const RMaterials::ETextureClampMode clampMode,
         uint32_t* id)
+{
+    int GL_minMagFilter = 0;
+    uint32_t texid = CreateTexture(minMagFiler, clampMode, &GL_minMagFilter);
+
+    glTexImage2D(GL_TEXTURE_2D,
+            0,
+            channels == 3 ? GL_RGB : GL_RGBA,
+            (GLsizei)width,
+            (GLsizei)height,
+            0,
+            channels == 3 ? GL_RGB : GL_RGBA,
+            GL_UNSIGNED_BYTE,
+            data);
+
+    if (genMipMaps || GL_minMagFilter == GL_NEAREST_MIPMAP_LINEAR || GL_minMagFilter == GL_NEAREST_MIPMAP_NEAREST)
+    {
+        glGenerateMipmap(GL_TEXTURE_2D);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    *id = texid;
+    return true;
+}
+
+bool CDisplayGL::LoadBC1TextureData(const unsigned char* blocks,
+        const unsigned int dataSize,
+        const unsigned int width,
+        const unsigned int height,
+        const RMaterials::ETextureClampMode clampMode,
+        uint32_t* id)
+{
+    if (!m_hasS3TC)
+    {
+        *id = 0;
+        return false;
+    }
+
+    // compressed textures cannot have mips generated, so level 0 only with a linear filter
+    int GL_minMagFilter = 0;
+    uint32_t texid = CreateTexture(RMaterials::TEXTURE_FILTER_LINEAR, clampMode, &GL_minMagFilter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+
+    glCompressedTexImage2D(GL_TEXTURE_2D,
+            0,
+            GL_COMPRESSED_RGB_S3TC_DXT1_EXT,
+            (GLsizei)width,
+            (GLsizei)height,
+            0,
+            (GLsizei)dataSize,
+            blocks);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    *id = texid;
+    return true;
+}
+
+uint32_t CDisplayGL::CreateTexture(
+        const RMaterials::ETextureFilterMode minMagFiler,
+        const RMaterials::ETextureClampMode clampMode,
+        int* outMinFilter)
 {
     // map RMaterials to GL
     int GL_minMagFilter = GL_LINEAR_MIPMAP_LINEAR;
@@ -152,24 +235,8 @@ bool CDisplayGL::LoadRAWTextureData(const unsigned char* data,
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_clampMode);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_clampMode);
 
-    glTexImage2D(GL_TEXTURE_2D,
-            0,
-            channels == 3 ? GL_RGB : GL_RGBA,
-            (GLsizei)width,
-            (GLsizei)height,
-            0,
-            channels == 3 ? GL_RGB : GL_RGBA,
-            GL_UNSIGNED_BYTE,
-            data);
-
-    if (genMipMaps || GL_minMagFilter == GL_NEAREST_MIPMAP_LINEAR || GL_minMagFilter == GL_NEAREST_MIPMAP_NEAREST)
-    {
-        glGenerateMipmap(GL_TEXTURE_2D);
-    }
-    glBindTexture(GL_TEXTURE_2D, 0);
-
-    *id = texid;
-    return true;
+    *outMinFilter = GL_minMagFilter;
+    return texid;
 }
 
 void CDisplayGL::SetViewport(int screenWidth, int screenHeight)
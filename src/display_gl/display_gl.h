@@ -5,6 +5,7 @@
 
 //#include "glm/glm.hpp"
 #include "shader_gl.h"
+#include "renderstate_gl.h"
 #include "mesh_gl.h"
 #include "rendertext_gl.h"
 #include "camera.h"
@@ -35,6 +36,14 @@ public:
             RMaterials::ETextureClampMode clampMode,
             uint32_t* id);
 
+    // GL_COMPRESSED_RGB_S3TC_DXT1_EXT blocks, fails when the driver has no S3TC support
+    bool LoadBC1TextureData(const unsigned char* blocks,
+            unsigned int dataSize,
+            unsigned int width,
+            unsigned int height,
+            RMaterials::ETextureClampMode clampMode,
+            uint32_t* id);
+
     void OnToggleDebug();
 
     void SetViewport(int screenWidth, int screenHeight);
@@ -46,6 +55,11 @@ public:
         return m_materialMgr;
     }
 
+    CRenderStateGL& GetRenderState()
+    {
+        return m_renderState;
+    }
+
     //
     // Meshes
     //
@@ -86,11 +100,18 @@ private:
     std::map<IRenderObj*, CRenderTextGL*> m_textMeshes;
 
     CMaterialManager m_materialMgr;
+    CRenderStateGL m_renderState;
 
     void DrawDebug();
 
+    // generates and binds a texture with the filter and clamp modes set
+    static uint32_t CreateTexture(RMaterials::ETextureFilterMode minMagFiler,
+            RMaterials::ETextureClampMode clampMode,
+            int* outMinFilter);
+
     int m_maxTextureSize = 1024;
     int m_maxTextureUnits = 16;
+    bool m_hasS3TC = false;
 
     std::map<std::string, Shader*> m_shaders;
 };
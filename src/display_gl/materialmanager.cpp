@@ -148,6 +148,17 @@ bool CMaterialManager::LoadRAWTextureData(
     return loaded;
 }
 
+bool CMaterialManager::LoadBC1TextureData(
+        const unsigned char* blocks,
+        const unsigned int dataSize,
+        const int width,
+        const int height,
+        const RMaterials::ETextureClampMode clampMode,
+        uint32_t* id)
+{
+    return m_display.LoadBC1TextureData(blocks, dataSize, width, height, clampMode, id);
+}
+
 bool CMaterialManager::DeleteTextureID(uint16_t texID)
 {
     return m_display.DeleteTextureID(texID);
@@ -28,6 +28,14 @@ public:
             RMaterials::ETextureClampMode clampMode,
             uint32_t* id);
 
+    bool LoadBC1TextureData(
+            const unsigned char* blocks,
+            unsigned int dataSize,
+            int width,
+            int height,
+            RMaterials::ETextureClampMode clampMode,
+            uint32_t* id);
+
     bool DeleteTextureID(uint16_t texID);
 
 private:
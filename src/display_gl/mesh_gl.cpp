@@ -5,7 +5,8 @@
 #include "display_gl.h"
 #include "material.h"
 #include "polymesh.h"
-#include "timer.h"
+
+#include <algorithm>
 
 using namespace NRenderTypes;
 
@@ -18,15 +19,16 @@ CMeshGL::CMeshGL(rade::polymesh& polymesh, CMaterialManager& matMgr)
 
 void CMeshGL::Reset()
 {
-    for (auto & x : m_vertBuffers)
-    {
-        delete [] x.second.vertBuffer;
-        x.second.copiedSoFar = 0;
-        x.second.mat = nullptr;
-        glDeleteBuffers(1, &x.second.glVBOId);
-        glDeleteVertexArrays(1, &x.second.glVAOId);
-    }
-    m_vertBuffers.clear();
+    glDeleteBuffers(1, &m_glIBOId);
+    glDeleteBuffers(1, &m_glVBOId);
+    glDeleteVertexArrays(1, &m_glVAOId);
+    m_glIBOId = m_glVBOId = m_glVAOId = 0;
+    m_drawRanges.clear();
+    m_cullTree.Clear();
+    m_rangeVisible.clear();
+    m_materialKeys.Clear();
+    m_shaderKeys.Clear();
+    m_shaders.clear();
 
     m_tmpFaces.clear();
     m_renderMode = NRenderTypes::ERenderDefault;
@@ -35,48 +37,103 @@ void CMeshGL::Reset()
 void CMeshGL::RenderAllFaces(CDisplayGL *display)
 {
     rade::Assert(m_camera, "Camera is null\n");
-    static rade::timer timer;
 
-    // generate VBO's for each section
-    for (auto & vbuff : m_vertBuffers)
+    if (m_drawRanges.empty())
+        return;
+
+    // shaders by id, looked up by name once
+    if (m_shaders.size() != m_shaderKeys.keys.size())
+    {
+        m_shaders.clear();
+        for (const std::string& shaderName : m_shaderKeys.keys)
+        {
+            Shader *shader = display->GetShader(shaderName);
+            rade::Assert(shader, "CMeshGL cant find shader %s\n", shaderName.c_str());
+            m_shaders.push_back(shader);
+        }
+    }
+
+    // planes in object space, so the range bounds are tested as they are
+    if (m_cullTree.IsBuilt())
+    {
+        rade::Frustrum frustrum;
+        frustrum.UpdateFrustrumPlanes(m_camera->GetMatrix() * m_transform.GetMatrix());
+        m_cullTree.CullFrustrum(frustrum, m_rangeVisible);
+    }
+    else
+    {
+        m_rangeVisible.assign(m_drawRanges.size(), 1);
+    }
+
+    CRenderStateGL& state = display->GetRenderState();
+    state.SetFrameCamera(m_camera);
+    state.BindVertexArray(m_glVAOId);
+
+    // ranges are sorted by shader and texture, so the state only changes between batches and
+    // each batch of ranges goes in one multi draw
+    uint32_t shaderID = UINT32_MAX;
+    GLuint boundTexID = 0;
+    GLuint boundLightmapID = 0;
+    bool texturesBound = false;
+    for (size_t i = 0; i < m_drawRanges.size(); i++)
     {
-        Shader *shader = display->GetShader(vbuff.second.shaderName);
-        rade::Assert(shader, "CMeshGL cant find shader %s\n", vbuff.second.shaderName.c_str());
-
-        shader->Use();
-        shader->SetMat4("projection", m_camera->GetProjection());
-        shader->SetMat4("view", m_camera->GetView());
-        shader->SetMat4("model", m_transform.GetMatrix());
-        shader->SetVec3("viewPos", m_camera->GetTransform().GetPosition());
-        shader->SetVec3("lightPos", rade::vector3(0, 0, 0));
-        shader->SetVec3("lightColor", rade::vector3(1, 1, 1));
-        shader->SetInt("lightmapTexture", 1);
-        shader->SetFloat("time", timer.ElapsedTime());
+        if (!m_rangeVisible[i])
+            continue;
 
+        const drawRange_t& range = m_drawRanges[i];
         GLuint texID = 1;
-        if(vbuff.second.mat != nullptr)
+        if(range.mat != nullptr)
         {
             using namespace RMaterials;
-            texID = vbuff.second.mat->GetTextureProps(TEXTURE_SLOT_DIFFUSE)->loadedTextureID;
+            texID = range.mat->GetTextureProps(TEXTURE_SLOT_DIFFUSE)->loadedTextureID;
         }
 
+        if (range.shaderID != shaderID)
+        {
+            FlushBatch();
+            shaderID = range.shaderID;
 
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, texID);
+            // projection, view and the rest of the per frame values are in the frame block
+            Shader *shader = m_shaders[shaderID];
+            state.UseShader(shader);
+            shader->SetMat4(EShaderUniform_Model, m_transform.GetMatrix());
+            shader->SetVec3(EShaderUniform_LightPos, 0.0f, 0.0f, 0.0f);
+            shader->SetVec3(EShaderUniform_LightColor, 1.0f, 1.0f, 1.0f);
+        }
 
-        if(vbuff.second.lightmapID != 0)
+        if (!texturesBound || texID != boundTexID || range.lightmapID != boundLightmapID)
         {
-            glActiveTexture(GL_TEXTURE1);
-            glBindTexture(GL_TEXTURE_2D, vbuff.second.lightmapID);
+            FlushBatch();
+            texturesBound = true;
+            boundTexID = texID;
+            boundLightmapID = range.lightmapID;
+
+            state.BindTexture(1, boundLightmapID);
+            state.BindTexture(0, boundTexID);
         }
 
-        glBindVertexArray(vbuff.second.glVAOId);
-        glDrawArrays(GL_TRIANGLES, 0, vbuff.second.numVerts);
+        m_batchCounts.push_back(static_cast<int>(range.numIndices));
+        m_batchOffsets.push_back(reinterpret_cast<const void*>(range.firstIndex * sizeof(uint32_t)));
+    }
+    FlushBatch();
+}
+
+void CMeshGL::FlushBatch()
+{
+    if (m_batchCounts.empty())
+        return;
 
-        glBindTexture(GL_TEXTURE_2D, 0);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, 0);
+    if (m_batchCounts.size() == 1)
+    {
+        glDrawElements(GL_TRIANGLES, m_batchCounts[0], GL_UNSIGNED_INT, m_batchOffsets[0]);
     }
+    else
+    {
+        glMultiDrawElements(GL_TRIANGLES, m_batchCounts.data(), GL_UNSIGNED_INT, m_batchOffsets.data(),
+                static_cast<GLsizei>(m_batchCounts.size()));
+    }
+    m_batchCounts.clear();
+    m_batchOffsets.clear();
 }
 
 void CMeshGL::AddFace(Tri& face)
@@ -86,118 +143,141 @@ void CMeshGL::AddFace(Tri& face)
 
 void CMeshGL::PrepareMesh()
 {
-    // lightmapID really needs to be in a sprite sheet / atlas
-    // make vertex buffer for each material key
-    for(Tri& face : m_tmpFaces)
-    {
-        std::string matKey = face.materialKey + "_" + std::to_string(face.lightmapID)  + "_" + face.shaderKey;
-        m_vertBuffers[matKey].numVerts += 3;// static_cast<uint16_t>(face.verts.size());
-    }
+    std::vector<Vert> verts;
+    std::vector<uint32_t> indices;
+    BuildBuffers(m_tmpFaces, cMaxRangeIndices, verts, indices, m_drawRanges);
 
-    // allocate mem for each new buffer
-    for (auto & x : m_vertBuffers)
-    {
-        x.second.vertBuffer = new Vert[x.second.numVerts];
-        x.second.copiedSoFar = 0;
-        x.second.mat = nullptr;
-    }
+    // one VAO over the shared buffers, the element buffer binding is part of the VAO state
+    glGenVertexArrays(1, &m_glVAOId);
+    glGenBuffers(1, &m_glVBOId);
+    glGenBuffers(1, &m_glIBOId);
+    glBindVertexArray(m_glVAOId);
+    glBindBuffer(GL_ARRAY_BUFFER, m_glVBOId);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(Vert) * verts.size(), verts.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_glIBOId);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(uint32_t) * indices.size(), indices.data(), GL_STATIC_DRAW);
 
-    // copy the raw vert info into the buffer structure
-    for(Tri& face : m_tmpFaces)
-    {
-        uint16_t copyIndex = 0;
-        for(const auto& v : face.verts)
-        {
-            std::string matKey = face.materialKey + "_" + std::to_string(face.lightmapID)  + "_" + face.shaderKey;
-            vertBuffer_t* vb = &m_vertBuffers[matKey];
-            vb->vertBuffer[vb->copiedSoFar] = face.verts[copyIndex];
-            vb->copiedSoFar++;
-            vb->materialName = face.materialKey;
-            vb->shaderName = face.shaderKey;
-            vb->mat = face.material;
-            vb->lightmapID = face.lightmapID;
-            copyIndex++;
-        }
-    }
-
-    // generate VAO and VBO for each section
-    for (auto & x : m_vertBuffers)
-    {
-        // generate vertex array id
-        glGenVertexArrays(1, &x.second.glVAOId);
-        glGenBuffers(1, &x.second.glVBOId);
-        glBindVertexArray(x.second.glVAOId);
-        glBindBuffer(GL_ARRAY_BUFFER, x.second.glVBOId);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(Vert) * x.second.numVerts, &x.second.vertBuffer[0], GL_STATIC_DRAW);
-
-        // use an empty Vert for offset into member data
-        Vert* vert = nullptr;
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vert), &vert->position);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vert), &vert->normal);
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vert), &vert->texCoord);
-        if(x.second.lightmapID != 0)
-        {
-            glVertexAttribPointer(3, 2, GL_FLOAT, GL_FALSE, sizeof(Vert), &vert->texCoordLM);
-            glEnableVertexAttribArray(3);
-        }
-        glEnableVertexAttribArray(0);
-        glEnableVertexAttribArray(1);
-        glEnableVertexAttribArray(2);
+    // use an empty Vert for offset into member data, polys without a lightmap have zero
+    // lightmap uvs
+    Vert* vert = nullptr;
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vert), &vert->position);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vert), &vert->normal);
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vert), &vert->texCoord);
+    glVertexAttribPointer(3, 2, GL_FLOAT, GL_FALSE, sizeof(Vert), &vert->texCoordLM);
+    glEnableVertexAttribArray(0);
+    glEnableVertexAttribArray(1);
+    glEnableVertexAttribArray(2);
+    glEnableVertexAttribArray(3);
 
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
-        glBindVertexArray(0);
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 
-        x.second.copiedSoFar = 0;
-    }
+    rade::Log("Mesh buffers: %zu verts (%zu before sharing), %zu indices, %zu draw ranges\n",
+            verts.size(), m_tmpFaces.size() * 3, indices.size(), m_drawRanges.size());
 
     m_tmpFaces.clear();
 }
 
 void CMeshGL::LoadMeshTexures(CMaterialManager& materialMgr, bool usePlatformAssets /*= false*/)
 {
-    for (auto & x : m_vertBuffers)
+    for (drawRange_t& range : m_drawRanges)
     {
-        if (x.second.mat == nullptr)
+        if (range.mat == nullptr)
         {
-            std::string materialKey = x.second.materialName;
+            const std::string& materialKey = m_materialKeys.keys[range.materialID];
             CMaterial* newMaterial = materialMgr.LoadFromKey(materialKey);
             if(!newMaterial)
             {
-                rade::Log("Failed to load material %s\n", x.second.materialName.c_str());
-                x.second.mat = nullptr;
+                rade::Log("Failed to load material %s\n", materialKey.c_str());
+                range.mat = nullptr;
             }
             else
             {
-                x.second.mat = newMaterial;
+                range.mat = newMaterial;
             }
         }
     }
+
+    SortDrawRanges();
+}
+
+void CMeshGL::SortDrawRanges()
+{
+    auto getTexID = [](const drawRange_t& range) -> uint32_t
+    {
+        using namespace RMaterials;
+        return range.mat ? range.mat->GetTextureProps(TEXTURE_SLOT_DIFFUSE)->loadedTextureID : 1;
+    };
+
+    std::stable_sort(m_drawRanges.begin(), m_drawRanges.end(),
+            [&getTexID](const drawRange_t& a, const drawRange_t& b)
+            {
+                if (a.shaderID != b.shaderID)
+                    return a.shaderID < b.shaderID;
+                if (getTexID(a) != getTexID(b))
+                    return getTexID(a) < getTexID(b);
+                return a.lightmapID < b.lightmapID;
+            });
+
+    // the tree holds range indices, so it is built once the order is final
+    std::vector<rade::BoundsTree::box_t> boxes;
+    boxes.reserve(m_drawRanges.size());
+    for (const drawRange_t& range : m_drawRanges)
+        boxes.push_back(range.bounds);
+    m_cullTree.Build(boxes);
+}
+
+bool CMeshGL::GetBoundingBox(rade::vector3& min, rade::vector3& max)
+{
+    rade::BoundsTree::box_t bounds;
+    if (!m_cullTree.GetBounds(&bounds))
+        return false;
+
+    min = rade::vector3(bounds.min[0], bounds.min[1], bounds.min[2]);
+    max = rade::vector3(bounds.max[0], bounds.max[1], bounds.max[2]);
+    return true;
 }
 
 void CMeshGL::InitFromPolyMesh(rade::polymesh& polyMesh)
 {
     std::vector<rade::poly3d>& polyList = polyMesh.GetPolyListRef();
     m_hasLightmaps = polyMesh.HasLightmaps();
+
+    size_t numFaces = 0;
+    for (const rade::poly3d& poly : polyList)
+        numFaces += poly.NumPoints() >= 3 ? poly.NumPoints() - 2 : 0;
+    m_tmpFaces.reserve(m_tmpFaces.size() + numFaces);
+
+    std::vector<Vert> polyVerts;
     for (rade::poly3d& poly : polyList)
     {
-        std::vector<rade::poly3d> polyTriangles = poly.ToTriangles();
-        for(auto& polyTri : polyTriangles)
+        const std::vector<rade::vector3>& points = poly.GetPointListRefConst();
+        if (points.size() < 3)
+            continue;
+
+        // the poly's verts once, then a fan over them
+        polyVerts.resize(points.size());
+        for (size_t i = 0; i < points.size(); i++)
         {
-            Tri renderTri {};
-            for(int i=0; i<3; i++)
-            {
-                Vert vert{};
-                polyTri.GetPoint(i).ToRenderVert(&vert);
-                vert.normal.x = poly.GetNormal().x;
-                vert.normal.y = poly.GetNormal().y;
-                vert.normal.z = poly.GetNormal().z;
-                renderTri.verts[i] = vert;
-            }
-            renderTri.shaderKey = poly.GetShaderKey();
-            renderTri.lightmapID = poly.GetLightTexID();
-            renderTri.materialKey = poly.GetMaterialKey();
+            Vert vert{};
+            points[i].ToRenderVert(&vert);
+            vert.normal.x = poly.GetNormal().x;
+            vert.normal.y = poly.GetNormal().y;
+            vert.normal.z = poly.GetNormal().z;
+            polyVerts[i] = vert;
+        }
+
+        Tri renderTri {};
+        renderTri.materialID = m_materialKeys.Intern(poly.GetMaterialKey());
+        renderTri.shaderID = m_shaderKeys.Intern(poly.GetShaderKey());
+        renderTri.lightmapID = poly.GetLightTexID();
+        for (size_t i = 0; i + 2 < points.size(); i++)
+        {
+            renderTri.verts[0] = polyVerts[0];
+            renderTri.verts[1] = polyVerts[i + 1];
+            renderTri.verts[2] = polyVerts[i + 2];
             AddFace(renderTri);
         }
     }
 }
-
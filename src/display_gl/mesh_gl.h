@@ -1,11 +1,12 @@
 #pragma once
 
 #include <vector>
-#include <map>
+#include <unordered_map>
 #include <cstdint>
 #include "rendertypes.h"
 #include "shader_gl.h"
 #include "irenderobj.h"
+#include "boundstree.h"
 
 #include <string>
 
@@ -33,17 +34,44 @@ public:
 
     CMeshGL(rade::polymesh& polymesh, CMaterialManager& matMgr);
 
-    struct vertBuffer_t
+    // triangles per draw range. Smaller ranges cull tighter but give the tree and the multi
+    // draws more entries, and it keeps every draw well under the GLsizei count limit
+    static const uint32_t cMaxRangeIndices = 3 * 4096;
+
+    // a piece of one bucket of the shared index buffer, numIndices indices from firstIndex that
+    // all draw with the same material, lightmap and shader. bounds is the object space box of
+    // its triangles, the unit the mesh is culled at
+    struct drawRange_t
     {
-        NRenderTypes::Vert* vertBuffer;
-        uint16_t numVerts;
-        unsigned int glVAOId;
-        unsigned int glVBOId;
-        std::string materialName;
-        std::string shaderName;
+        uint32_t firstIndex;
+        uint32_t numIndices;
+        uint32_t materialID;
+        uint32_t shaderID;
         CMaterial* mat;
-        uint16_t copiedSoFar;
         unsigned int lightmapID;
+        rade::BoundsTree::box_t bounds;
+    };
+
+    // strings given a small integer id the first time they are seen, so faces carry ids
+    // instead of keys
+    struct keyTable_t
+    {
+        std::unordered_map<std::string, uint32_t> ids;
+        std::vector<std::string> keys;
+
+        uint32_t Intern(const std::string& key)
+        {
+            auto inserted = ids.insert(std::make_pair(key, static_cast<uint32_t>(keys.size())));
+            if (inserted.second)
+                keys.push_back(key);
+            return inserted.first->second;
+        }
+
+        void Clear()
+        {
+            ids.clear();
+            keys.clear();
+        }
     };
 
     void InitFromPolyMesh(rade::polymesh& renderMesh);
@@ -68,14 +96,44 @@ public:
 
     void PrepareMesh();
 
-    void GetBoundingBox() override{};
+    // fills one shared vertex and index buffer and the draw ranges from the faces, no GL calls.
+    // Each bucket's faces are ordered along a space filling curve and cut into ranges of at most
+    // maxRangeIndices, so the ranges are spatially compact
+    static void BuildBuffers(const std::vector<NRenderTypes::Tri>& faces,
+            uint32_t maxRangeIndices,
+            std::vector<NRenderTypes::Vert>& outVerts,
+            std::vector<uint32_t>& outIndices,
+            std::vector<drawRange_t>& outRanges);
+
+    bool GetBoundingBox(rade::vector3& min, rade::vector3& max) override;
 
 private:
 
     NRenderTypes::ERenderMode m_renderMode = NRenderTypes::ERenderDefault;
 
     std::vector<NRenderTypes::Tri> m_tmpFaces;
-    std::map<std::string, vertBuffer_t> m_vertBuffers;
+    keyTable_t m_materialKeys;
+    keyTable_t m_shaderKeys;
+    std::vector<Shader*> m_shaders;
+
+    // every bucket shares one VAO, vertex and index buffer
+    std::vector<drawRange_t> m_drawRanges;
+    unsigned int m_glVAOId = 0;
+    unsigned int m_glVBOId = 0;
+    unsigned int m_glIBOId = 0;
+
+    // the ranges by bounds, and which of them passed the last frustum test
+    rade::BoundsTree m_cullTree;
+    std::vector<uint8_t> m_rangeVisible;
+
+    // counts and offsets of the draw being batched, kept between frames
+    std::vector<int> m_batchCounts;
+    std::vector<const void*> m_batchOffsets;
+
+    // orders the ranges so ones with the same shader and textures are next to each other
+    void SortDrawRanges();
+
+    void FlushBatch();
 
     glm::mat4 m_model = glm::mat4(1);
 
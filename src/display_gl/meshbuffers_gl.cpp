@@ -0,0 +1,220 @@
+#include "mesh_gl.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <unordered_map>
+
+// CMeshGL::BuildBuffers, kept apart from the GL side of the mesh so it builds and is tested
+// without a context
+
+using namespace NRenderTypes;
+
+namespace
+{
+    // vertices are only shared when every attribute matches bit for bit
+    struct VertHash
+    {
+        size_t operator()(const Vert& v) const
+        {
+            uint32_t words[sizeof(Vert) / sizeof(uint32_t)];
+            memcpy(words, &v, sizeof(Vert));
+            uint64_t hash = 14695981039346656037ull;
+            for (uint32_t word : words)
+                hash = (hash ^ word) * 1099511628211ull;
+            return static_cast<size_t>(hash ^ (hash >> 32));
+        }
+    };
+
+    struct VertEqual
+    {
+        bool operator()(const Vert& a, const Vert& b) const
+        {
+            return memcmp(&a, &b, sizeof(Vert)) == 0;
+        }
+    };
+
+    // the state a face is drawn with
+    struct bucketkey_t
+    {
+        uint32_t shaderID;
+        uint32_t materialID;
+        uint32_t lightmapID;
+
+        bool operator==(const bucketkey_t& other) const
+        {
+            return shaderID == other.shaderID && materialID == other.materialID && lightmapID == other.lightmapID;
+        }
+    };
+
+    struct BucketKeyHash
+    {
+        size_t operator()(const bucketkey_t& key) const
+        {
+            uint64_t hash = (static_cast<uint64_t>(key.shaderID) << 32 | key.materialID) * 0x9E3779B97F4A7C15ull;
+            return static_cast<size_t>(hash ^ key.lightmapID);
+        }
+    };
+
+    // spreads the low 10 bits of v out to every third bit
+    uint32_t SpreadBits(uint32_t v)
+    {
+        v = (v | (v << 16)) & 0x030000FF;
+        v = (v | (v << 8)) & 0x0300F00F;
+        v = (v | (v << 4)) & 0x030C30C3;
+        v = (v | (v << 2)) & 0x09249249;
+        return v;
+    }
+
+    // position on a z order curve through the mesh bounds, faces close in the order are close
+    // in space
+    uint32_t MortonCode(const Tri& face, const float* min, const float* scale)
+    {
+        const float* p[3] = { &face.verts[0].position.x, &face.verts[1].position.x, &face.verts[2].position.x };
+        uint32_t code = 0;
+        for (int axis = 0; axis < 3; axis++)
+        {
+            float center = (p[0][axis] + p[1][axis] + p[2][axis]) / 3.0f;
+            float cell = std::min(std::max((center - min[axis]) * scale[axis], 0.0f), 1023.0f);
+            code |= SpreadBits(static_cast<uint32_t>(cell)) << axis;
+        }
+        return code;
+    }
+}
+
+void CMeshGL::BuildBuffers(const std::vector<Tri>& faces,
+        uint32_t maxRangeIndices,
+        std::vector<Vert>& outVerts,
+        std::vector<uint32_t>& outIndices,
+        std::vector<drawRange_t>& outRanges)
+{
+    outVerts.clear();
+    outIndices.clear();
+    outRanges.clear();
+
+    // a bucket per shader, material and lightmap. The faces of a poly come in a row, so the
+    // hash lookup only happens when the key changes
+    std::unordered_map<bucketkey_t, uint32_t, BucketKeyHash> bucketIndex;
+    std::vector<uint32_t> faceBuckets(faces.size());
+    bucketkey_t lastKey = { UINT32_MAX, UINT32_MAX, UINT32_MAX };
+    uint32_t lastBucket = 0;
+    for (size_t i = 0; i < faces.size(); i++)
+    {
+        const Tri& face = faces[i];
+        bucketkey_t key = { face.shaderID, face.materialID, face.lightmapID };
+        if (!(key == lastKey))
+        {
+            auto inserted = bucketIndex.insert(std::make_pair(key, static_cast<uint32_t>(outRanges.size())));
+            if (inserted.second)
+            {
+                drawRange_t range {};
+                range.materialID = face.materialID;
+                range.shaderID = face.shaderID;
+                range.mat = nullptr;
+                range.lightmapID = face.lightmapID;
+                outRanges.push_back(range);
+            }
+            lastKey = key;
+            lastBucket = inserted.first->second;
+        }
+        faceBuckets[i] = lastBucket;
+        outRanges[lastBucket].numIndices += 3;
+    }
+
+    // counting sort, each bucket gets a contiguous run of the index buffer
+    uint32_t numIndices = 0;
+    for (drawRange_t& range : outRanges)
+    {
+        range.firstIndex = numIndices;
+        numIndices += range.numIndices;
+    }
+
+    std::vector<uint32_t> faceOrder(faces.size());
+    std::vector<uint32_t> bucketCursor(outRanges.size());
+    for (size_t i = 0; i < outRanges.size(); i++)
+        bucketCursor[i] = outRanges[i].firstIndex / 3;
+    for (size_t i = 0; i < faces.size(); i++)
+        faceOrder[bucketCursor[faceBuckets[i]]++] = static_cast<uint32_t>(i);
+
+    // then along the z order curve inside each bucket
+    float boundsMin[3] = { std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max() };
+    float boundsMax[3] = { -std::numeric_limits<float>::max(), -std::numeric_limits<float>::max(), -std::numeric_limits<float>::max() };
+    for (const Tri& face : faces)
+    {
+        for (const Vert& v : face.verts)
+        {
+            const float* p = &v.position.x;
+            for (int axis = 0; axis < 3; axis++)
+            {
+                boundsMin[axis] = std::min(boundsMin[axis], p[axis]);
+                boundsMax[axis] = std::max(boundsMax[axis], p[axis]);
+            }
+        }
+    }
+    float scale[3];
+    for (int axis = 0; axis < 3; axis++)
+    {
+        float extent = boundsMax[axis] - boundsMin[axis];
+        scale[axis] = extent > 0.0f ? 1023.0f / extent : 0.0f;
+    }
+
+    // sorting code and face index packed together is much quicker than sorting indices by a
+    // looked up code
+    std::vector<uint64_t> faceKeys(faces.size());
+    for (size_t i = 0; i < faces.size(); i++)
+        faceKeys[i] = static_cast<uint64_t>(MortonCode(faces[faceOrder[i]], boundsMin, scale)) << 32 | faceOrder[i];
+    for (const drawRange_t& range : outRanges)
+    {
+        auto first = faceKeys.begin() + range.firstIndex / 3;
+        std::sort(first, first + range.numIndices / 3);
+    }
+    for (size_t i = 0; i < faces.size(); i++)
+        faceOrder[i] = static_cast<uint32_t>(faceKeys[i]);
+
+    // the fans over each poly repeat most of their points, each distinct vertex is
+    // stored once
+    outIndices.resize(numIndices);
+    std::unordered_map<Vert, uint32_t, VertHash, VertEqual> vertIndex(faces.size() * 2);
+    uint32_t cursor = 0;
+    for (uint32_t face : faceOrder)
+    {
+        for (const Vert& v : faces[face].verts)
+        {
+            auto inserted = vertIndex.insert(std::make_pair(v, static_cast<uint32_t>(outVerts.size())));
+            if (inserted.second)
+                outVerts.push_back(v);
+            outIndices[cursor++] = inserted.first->second;
+        }
+    }
+
+    // cut the buckets into ranges, the pieces share their state so neighbours that are all in
+    // view still go out in the same multi draw
+    maxRangeIndices -= maxRangeIndices % 3;
+    std::vector<drawRange_t> ranges;
+    ranges.swap(outRanges);
+    for (const drawRange_t& range : ranges)
+    {
+        for (uint32_t first = 0; first < range.numIndices; first += maxRangeIndices)
+        {
+            drawRange_t piece = range;
+            piece.firstIndex = range.firstIndex + first;
+            piece.numIndices = std::min(maxRangeIndices, range.numIndices - first);
+
+            for (int axis = 0; axis < 3; axis++)
+            {
+                piece.bounds.min[axis] = std::numeric_limits<float>::max();
+                piece.bounds.max[axis] = -std::numeric_limits<float>::max();
+            }
+            for (uint32_t i = piece.firstIndex; i < piece.firstIndex + piece.numIndices; i++)
+            {
+                const float* p = &outVerts[outIndices[i]].position.x;
+                for (int axis = 0; axis < 3; axis++)
+                {
+                    piece.bounds.min[axis] = std::min(piece.bounds.min[axis], p[axis]);
+                    piece.bounds.max[axis] = std::max(piece.bounds.max[axis], p[axis]);
+                }
+            }
+            outRanges.push_back(piece);
+        }
+    }
+}
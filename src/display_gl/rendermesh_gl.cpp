@@ -9,9 +9,9 @@
 
 using namespace NRenderTypes;
 
-void CRenderMeshGL::OnRenderStart()
+void CRenderMeshGL::OnRenderStart(CRenderStateGL& state)
 {
-    glBindVertexArray(m_vaoId);
+    state.BindVertexArray(m_vaoId);
     glEnableVertexAttribArray(0);
     glEnableVertexAttribArray(1);
     glEnableVertexAttribArray(2);
@@ -19,12 +19,10 @@ void CRenderMeshGL::OnRenderStart()
 
 void CRenderMeshGL::OnRenderFinish()
 {
-    // restore all states
+    // the arrays are part of this mesh's VAO, which stays bound for the render state to skip
     glDisableVertexAttribArray(2);
     glDisableVertexAttribArray(1);
     glDisableVertexAttribArray(0);
-
-    glBindVertexArray(0);
 }
 
 void CRenderMeshGL::Reset()
@@ -46,14 +44,17 @@ void CRenderMeshGL::Reset()
     m_renderMode = NRenderTypes::ERenderDefault;
 }
 
-void CRenderMeshGL::RenderAllFaces(const rade::Camera& cam)
+void CRenderMeshGL::RenderAllFaces(CDisplayGL* display, rade::Camera* camera)
 {
-    OnRenderStart();
+    rade::Assert(camera, "Camera is null\n");
+
+    CRenderStateGL& state = display->GetRenderState();
+    state.SetFrameCamera(camera);
+    OnRenderStart(state);
 
-    m_meshShader.Use();
-    m_meshShader.SetMat4("projection", cam.GetProjection());
-    m_meshShader.SetMat4("view", cam.GetView());
-    m_meshShader.SetMat4("model", m_model);
+    // projection and view come from the display's FrameUniforms block
+    state.UseShader(&m_meshShader);
+    m_meshShader.SetMat4(EShaderUniform_Model, m_model);
 
     for (auto & x : m_vertBuffers)
     {
@@ -107,18 +108,16 @@ void CRenderMeshGL::RenderAllFaces(const rade::Camera& cam)
 //                    &vert->texCoordLM);   // pointer
 //        }
 
-        glActiveTexture(GL_TEXTURE0);
-
         GLuint texID = 1;
         if(x.second.mat != nullptr)
         {
             using namespace RMaterials;
             texID = x.second.mat->GetTextureProps(TEXTURE_SLOT_DIFFUSE)->loadedTextureID;
         }
-        glBindTexture(GL_TEXTURE_2D, texID);
+        state.BindTexture(0, texID);
 
         //glDrawArrays(GL_TRIANGLES, 0, x.second.numVerts);
-        glDrawArrays(GL_TRIANGLE_FAN, 0, x.second.numVerts);
+        glDrawArrays(GL_TRIANGLE_FAN, 0, static_cast<GLsizei>(x.second.numVerts));
     }
     OnRenderFinish();
 }
@@ -133,7 +132,7 @@ void CRenderMeshGL::PrepareMesh(CDisplayGL& displayGl, bool loadTextures, bool u
     // make 1 big vert buffer
     for(Face& face : m_tmpFaces)
     {
-        m_vertBuffers[face.materialKey].numVerts += static_cast<uint16_t>(face.verts.size());
+        m_vertBuffers[face.materialKey].numVerts += static_cast<uint32_t>(face.verts.size());
     }
 
     // allocate mem for each new buffer
@@ -147,7 +146,7 @@ void CRenderMeshGL::PrepareMesh(CDisplayGL& displayGl, bool loadTextures, bool u
     // copy the vert info into the buffer structure
     for(Face& face : m_tmpFaces)
     {
-        uint16_t copyIndex = 0;
+        uint32_t copyIndex = 0;
         for(const auto& v : face.verts)
         {
             m_vertBuffers[face.materialKey].vertBuffer[m_vertBuffers[face.materialKey].copiedSoFar] =
@@ -10,6 +10,8 @@
 
 class CDisplayGL;
 
+class CRenderStateGL;
+
 class CMaterial;
 
 namespace rade
@@ -26,18 +28,19 @@ public:
     struct vertBuffer_t
     {
         NRenderTypes::Vert* vertBuffer;
-        uint16_t numVerts;
+        uint32_t numVerts;
         unsigned int glVBOId;
         std::string materialName;
         CMaterial *mat;
-        uint16_t copiedSoFar;
+        uint32_t copiedSoFar;
     };
 
     void InitFromPolyMesh(rade::polymesh& renderMesh);
 
     void AddFace(NRenderTypes::Face& face);
 
-    void RenderAllFaces(const rade::Camera& cam);
+    // binds through the display's render state, which fills the frame block from the camera
+    void RenderAllFaces(CDisplayGL* display, rade::Camera* camera);
 
     void Reset();
 
@@ -64,7 +67,7 @@ private:
     std::vector<NRenderTypes::Face> m_tmpFaces;
     std::map<std::string, vertBuffer_t> m_vertBuffers;
 
-    void OnRenderStart();
+    void OnRenderStart(CRenderStateGL& state);
 
     void OnRenderFinish();
 
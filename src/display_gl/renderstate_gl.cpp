@@ -0,0 +1,91 @@
+#include <glad/glad.h>
+
+#include "renderstate_gl.h"
+#include "shader_gl.h"
+#include "camera.h"
+#include "osutils.h"
+
+namespace
+{
+    // never a real GL name, so the first bind after Invalidate() is not skipped
+    const unsigned int cUnknown = 0xFFFFFFFF;
+}
+
+void CRenderStateGL::Init()
+{
+    glGenBuffers(1, &m_frameUBO);
+    glBindBuffer(GL_UNIFORM_BUFFER, m_frameUBO);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(frameuniforms_t), nullptr, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    glBindBufferBase(GL_UNIFORM_BUFFER, cFrameUniformsBinding, m_frameUBO);
+
+    Invalidate();
+}
+
+void CRenderStateGL::Shutdown()
+{
+    glDeleteBuffers(1, &m_frameUBO);
+    m_frameUBO = 0;
+}
+
+void CRenderStateGL::Invalidate()
+{
+    m_frameCamera = nullptr;
+    m_program = cUnknown;
+    m_vaoId = cUnknown;
+    m_activeUnit = -1;
+    for (unsigned int& texID : m_textures)
+        texID = cUnknown;
+}
+
+void CRenderStateGL::UseShader(const Shader* shader)
+{
+    if (shader->GetShaderID() == m_program)
+        return;
+
+    m_program = shader->GetShaderID();
+    shader->Use();
+}
+
+void CRenderStateGL::BindVertexArray(unsigned int vaoId)
+{
+    if (vaoId == m_vaoId)
+        return;
+
+    m_vaoId = vaoId;
+    glBindVertexArray(vaoId);
+}
+
+void CRenderStateGL::BindTexture(int unit, unsigned int texID)
+{
+    rade::Assert(unit >= 0 && unit < cMaxTextureUnits, "texture unit %d out of range\n", unit);
+    if (m_textures[unit] == texID)
+        return;
+
+    if (unit != m_activeUnit)
+    {
+        m_activeUnit = unit;
+        glActiveTexture(GL_TEXTURE0 + unit);
+    }
+    m_textures[unit] = texID;
+    glBindTexture(GL_TEXTURE_2D, texID);
+}
+
+void CRenderStateGL::SetFrameCamera(rade::Camera* camera)
+{
+    // cameras do not move during a frame, and Invalidate() clears this every frame
+    if (camera == m_frameCamera)
+        return;
+
+    m_frameCamera = camera;
+
+    frameuniforms_t frame{};
+    frame.projection = camera->GetProjection();
+    frame.view = camera->GetView();
+    camera->GetTransform().GetPosition().ToFloat3(frame.viewPos);
+    frame.time = m_timer.ElapsedTime();
+
+    glBindBuffer(GL_UNIFORM_BUFFER, m_frameUBO);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(frameuniforms_t), &frame);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "glm/glm.hpp"
+#include "timer.h"
+
+class Shader;
+
+namespace rade
+{
+    class Camera;
+};
+
+// the GL state the renderers change between draws. Binds that would set what is already bound
+// are skipped, so the renderers bind what they need without unbinding after. Anything else
+// that touches GL (imgui, texture uploads) leaves it stale, the display calls Invalidate() at
+// the start of every frame
+class CRenderStateGL
+{
+public:
+
+    static const int cMaxTextureUnits = 4;
+
+    void Init();
+
+    void Shutdown();
+
+    // forget what is bound, the next bind of each kind always goes through
+    void Invalidate();
+
+    void UseShader(const Shader* shader);
+
+    void BindVertexArray(unsigned int vaoId);
+
+    void BindTexture(int unit, unsigned int texID);
+
+    // fills the FrameUniforms block from the camera, nothing to do if it already holds it
+    void SetFrameCamera(rade::Camera* camera);
+
+private:
+
+    // std140 layout of the FrameUniforms block in the shaders
+    typedef struct
+    {
+        glm::mat4 projection;
+        glm::mat4 view;
+        float viewPos[4];
+        float time;
+        float pad[3];
+    } frameuniforms_t;
+
+    unsigned int m_frameUBO = 0;
+    rade::Camera* m_frameCamera = nullptr;
+    rade::timer m_timer;
+
+    unsigned int m_program = 0;
+    unsigned int m_vaoId = 0;
+    int m_activeUnit = 0;
+    unsigned int m_textures[cMaxTextureUnits] = {};
+};
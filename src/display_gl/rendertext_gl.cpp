@@ -28,7 +28,7 @@ CRenderTextGL::CRenderTextGL(CDisplayGL* display, rade::polymesh* polyMesh)
 
 void CRenderTextGL::OnRenderStart()
 {
-    glBindVertexArray(m_vaoId);
+    // the vao is bound through the render state, the enables are part of it
     glEnableVertexAttribArray(0);
     glEnableVertexAttribArray(1);
     glEnableVertexAttribArray(2);
@@ -36,12 +36,7 @@ void CRenderTextGL::OnRenderStart()
 
 void CRenderTextGL::OnRenderFinish()
 {
-    // restore all states
-    glDisableVertexAttribArray(2);
-    glDisableVertexAttribArray(1);
-    glDisableVertexAttribArray(0);
-
-    glBindVertexArray(0);
+    // nothing to restore, the render state skips whatever is still bound next time
 
     //glBindTexture(GL_TEXTURE_2D, 0);
     //glActiveTexture(0);
@@ -54,13 +49,13 @@ void CRenderTextGL::RenderAllFaces(CDisplayGL& display)
     Shader *shader = display.GetShader("font");
     rade::Assert(shader, "CMeshGL cant find shader font\n");
 
-    shader->Use();
-    shader->SetMat4("projection", m_camera->GetProjection());
-    shader->SetMat4("view", m_camera->GetView());
-    shader->SetMat4("model", m_transform.GetMatrix());
+    CRenderStateGL& state = display.GetRenderState();
+    state.SetFrameCamera(m_camera);
+    state.UseShader(shader);
+    shader->SetMat4(EShaderUniform_Model, m_transform.GetMatrix());
 
+    state.BindVertexArray(m_vaoId);
     OnRenderStart();
-    glBindVertexArray(m_vaoId);
 
     // dont loop all faces, just use the ones we need to render the string
     // UVs are not stored - look them up each time and pass to shaders for fast dynamic rendering
@@ -106,12 +101,10 @@ void CRenderTextGL::RenderAllFaces(CDisplayGL& display)
                 sizeof(Vert),       // stride
                 &vert->texCoord);   // pointer
 
-        glActiveTexture(GL_TEXTURE0);
-
         rade::vector2 uvOffset = GetGlyphPosition(glyphChar);
-        shader->SetVec2("glyphOffset", uvOffset.x, uvOffset.y);
+        shader->SetVec2(EShaderUniform_GlyphOffset, uvOffset.x, uvOffset.y);
 
-        glBindTexture(GL_TEXTURE_2D, m_texid);
+        state.BindTexture(0, m_texid);
 
         glDrawArrays(GL_TRIANGLE_FAN, 0, (GLsizei)face.verts.size());
     }
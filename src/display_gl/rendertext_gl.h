@@ -92,7 +92,10 @@ public:
 
 	void UpdateText(const std::string& newText);
 
-    void GetBoundingBox() override {};
+    bool GetBoundingBox(rade::vector3& min, rade::vector3& max) override
+    {
+        return false;
+    }
 
     void Reset();
 
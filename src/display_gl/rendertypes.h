@@ -47,12 +47,9 @@ namespace NRenderTypes
 
 	typedef struct
     {
-        //unsigned int glVBOId; // VBOID
-        std::string materialKey;
-        std::string shaderKey;
+        uint32_t materialID;    // index into the mesh's material keys
+        uint32_t shaderID;      // index into the mesh's shader keys
         uint32_t lightmapID;
-        //CGLTexture *texture;
-        CMaterial *material;
         Vert verts[3];
     } Tri;
 
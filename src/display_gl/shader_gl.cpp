@@ -9,6 +9,17 @@
 
 using namespace rade;
 
+namespace
+{
+    const char* cUniformNames[EShaderUniform_Count] =
+    {
+        "model",
+        "lightPos",
+        "lightColor",
+        "glyphOffset"
+    };
+}
+
 void Shader::Use() const
 {
     glUseProgram(GetShaderID());
@@ -115,9 +126,32 @@ bool Shader::LinkPrg()
         m_prog.prgID = 0;
         return false;
     }
+
+    ResolveUniforms();
     return true;
 }
 
+void Shader::ResolveUniforms()
+{
+    for (int i = 0; i < EShaderUniform_Count; i++)
+        m_locations[i] = glGetUniformLocation(m_prog.prgID, cUniformNames[i]);
+
+    GLuint blockIndex = glGetUniformBlockIndex(m_prog.prgID, "FrameUniforms");
+    if (blockIndex != GL_INVALID_INDEX)
+        glUniformBlockBinding(m_prog.prgID, blockIndex, cFrameUniformsBinding);
+
+    // samplers never change unit, so they are set here rather than every draw. Programs are
+    // linked outside of a frame, the render state is invalidated before it is used again
+    glUseProgram(m_prog.prgID);
+    GLint diffuseLoc = glGetUniformLocation(m_prog.prgID, "diffuseTexture");
+    if (diffuseLoc != -1)
+        glUniform1i(diffuseLoc, 0);
+    GLint lightmapLoc = glGetUniformLocation(m_prog.prgID, "lightmapTexture");
+    if (lightmapLoc != -1)
+        glUniform1i(lightmapLoc, 1);
+    glUseProgram(0);
+}
+
 int Shader::GetAttribLoc(const char *name) const
 {
     int attrib = glGetAttribLocation(m_prog.prgID, name);
@@ -214,3 +248,18 @@ void Shader::SetMat4(const std::string &name, const glm::mat4 &mat)
 {
 	glUniformMatrix4fv(GetUniformLocation(name), 1, GL_FALSE, &mat[0][0]);
 }
+
+void Shader::SetVec2(EShaderUniform uniform, float x, float y)
+{
+    glUniform2f(m_locations[uniform], x, y);
+}
+
+void Shader::SetVec3(EShaderUniform uniform, float x, float y, float z)
+{
+    glUniform3f(m_locations[uniform], x, y, z);
+}
+
+void Shader::SetMat4(EShaderUniform uniform, const glm::mat4& mat)
+{
+    glUniformMatrix4fv(m_locations[uniform], 1, GL_FALSE, &mat[0][0]);
+}
@@ -21,6 +21,21 @@ namespace rade
     class vector3;
 }
 
+// uniforms set on every draw, their locations are looked up once when the program links.
+// Programs without one get -1, which GL ignores
+enum EShaderUniform
+{
+    EShaderUniform_Model = 0,
+    EShaderUniform_LightPos,
+    EShaderUniform_LightColor,
+    EShaderUniform_GlyphOffset,
+    EShaderUniform_Count
+};
+
+// the FrameUniforms block (projection, view, viewPos and time) every program reads from this
+// uniform buffer binding, CRenderStateGL fills it once per camera per frame
+const unsigned int cFrameUniformsBinding = 0;
+
 typedef struct
 {
     unsigned int prgID;
@@ -39,6 +54,11 @@ public:
 
     int GetUniformLocation(const std::string& name);
 
+    int GetUniformLocation(EShaderUniform uniform) const
+    {
+        return m_locations[uniform];
+    }
+
     unsigned int GetShaderID() const
     {
         return m_prog.prgID;
@@ -73,13 +93,23 @@ public:
     // delete
     void SetMat4(const std::string &name, const glm::mat4 &mat);
 
+    void SetVec2(EShaderUniform uniform, float x, float y);
+
+    void SetVec3(EShaderUniform uniform, float x, float y, float z);
+
+    void SetMat4(EShaderUniform uniform, const glm::mat4& mat);
+
 private:
 
     unsigned int CompileShader(const char* shader, unsigned int type, int num_bytes);
 
     bool LinkPrg();
 
+    // the EShaderUniform locations, the frame block binding and fixed sampler units
+    void ResolveUniforms();
+
     ShaderPrg m_prog{};
+    int m_locations[EShaderUniform_Count] = {};
     std::map<std::string, int> m_uniformLocations;
     std::string m_name;
 };
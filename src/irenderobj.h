@@ -63,7 +63,8 @@ public:
         return m_text;
     }
 
-    virtual void GetBoundingBox() = 0;
+    // bounds in object space, before the transform. false if there is nothing to bound
+    virtual bool GetBoundingBox(rade::vector3& min, rade::vector3& max) = 0;
 
 protected:
     bool m_enabled = false;
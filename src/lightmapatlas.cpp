@@ -0,0 +1,166 @@
+#include <algorithm>
+#include <cstring>
+#include "lightmapatlas.h"
+
+CLightmapAtlas::CLightmapAtlas(uint16_t pageSize, uint16_t padding)
+        : m_pageSize(pageSize), m_padding(padding)
+{
+}
+
+atlasrect_t CLightmapAtlas::Insert(uint16_t width, uint16_t height)
+{
+    auto paddedWidth = static_cast<uint16_t>(width + m_padding * 2);
+    auto paddedHeight = static_cast<uint16_t>(height + m_padding * 2);
+
+    uint16_t x = 0;
+    uint16_t y = 0;
+    size_t pageIndex = 0;
+    for (; pageIndex < m_pages.size(); pageIndex++)
+    {
+        if (FindPosition(m_pages[pageIndex], paddedWidth, paddedHeight, &x, &y))
+            break;
+    }
+
+    if (pageIndex == m_pages.size())
+    {
+        OpenPage(std::max(m_pageSize, paddedWidth), std::max(m_pageSize, paddedHeight));
+        x = 0;
+        y = 0;
+    }
+
+    page_t& page = m_pages[pageIndex];
+    AddToSkyline(page, x, y, paddedWidth, paddedHeight);
+    page.usedWidth = std::max<uint16_t>(page.usedWidth, static_cast<uint16_t>(x + paddedWidth));
+    page.usedHeight = std::max<uint16_t>(page.usedHeight, static_cast<uint16_t>(y + paddedHeight));
+
+    atlasrect_t rect;
+    rect.page = static_cast<uint32_t>(pageIndex);
+    rect.x = static_cast<uint16_t>(x + m_padding);
+    rect.y = static_cast<uint16_t>(y + m_padding);
+    rect.width = width;
+    rect.height = height;
+    return rect;
+}
+
+void CLightmapAtlas::BuildPages(
+        const std::vector<CLightmapImg*>& images,
+        const std::vector<atlasrect_t>& rects,
+        std::vector<CLightmapImg*>* pages) const
+{
+    size_t firstPage = pages->size();
+    for (const page_t& page : m_pages)
+        pages->push_back(new CLightmapImg(page.usedWidth, page.usedHeight));
+
+    int padding = m_padding;
+    for (size_t i = 0; i < images.size(); i++)
+    {
+        CLightmapImg* src = images[i];
+        const atlasrect_t& rect = rects[i];
+        CLightmapImg* dst = pages->at(firstPage + rect.page);
+
+        // the padding repeats the nearest edge lumel
+        for (int y = -padding; y < rect.height + padding; y++)
+        {
+            int srcY = std::min(std::max(y, 0), src->m_height - 1);
+            for (int x = -padding; x < rect.width + padding; x++)
+            {
+                int srcX = std::min(std::max(x, 0), src->m_width - 1);
+                memcpy(dst->GetPixel(rect.x + x, rect.y + y), src->GetPixel(srcX, srcY), 4);
+            }
+        }
+    }
+}
+
+bool CLightmapAtlas::FindPosition(const page_t& page, uint16_t width, uint16_t height, uint16_t* outX, uint16_t* outY)
+{
+    bool found = false;
+    int bestTop = 0;
+    int bestX = 0;
+
+    const std::vector<skyline_t>& skyline = page.skyline;
+    for (size_t i = 0; i < skyline.size(); i++)
+    {
+        int x = skyline[i].x;
+        if (x + width > page.width)
+            break;
+
+        // the rect rests on the highest run it spans
+        int y = 0;
+        int remaining = width;
+        for (size_t j = i; remaining > 0; j++)
+        {
+            y = std::max<int>(y, skyline[j].y);
+            remaining -= skyline[j].width;
+        }
+
+        int top = y + height;
+        if (top > page.height)
+            continue;
+
+        if (!found || top < bestTop || (top == bestTop && x < bestX))
+        {
+            found = true;
+            bestTop = top;
+            bestX = x;
+            *outX = static_cast<uint16_t>(x);
+            *outY = static_cast<uint16_t>(y);
+        }
+    }
+    return found;
+}
+
+void CLightmapAtlas::AddToSkyline(page_t& page, uint16_t x, uint16_t y, uint16_t width, uint16_t height)
+{
+    int left = x;
+    int right = x + width;
+
+    std::vector<skyline_t> skyline;
+    skyline.reserve(page.skyline.size() + 2);
+    bool inserted = false;
+    for (const skyline_t& run : page.skyline)
+    {
+        int runRight = run.x + run.width;
+        if (runRight <= left || run.x >= right)
+        {
+            if (run.x >= right && !inserted)
+            {
+                skyline.push_back({ x, static_cast<uint16_t>(y + height), width });
+                inserted = true;
+            }
+            skyline.push_back(run);
+            continue;
+        }
+
+        // the run is partly or wholly covered by the new rect, keep what sticks out either side
+        if (run.x < left)
+            skyline.push_back({ run.x, run.y, static_cast<uint16_t>(left - run.x) });
+        if (!inserted)
+        {
+            skyline.push_back({ x, static_cast<uint16_t>(y + height), width });
+            inserted = true;
+        }
+        if (runRight > right)
+            skyline.push_back({ static_cast<uint16_t>(right), run.y, static_cast<uint16_t>(runRight - right) });
+    }
+
+    // join neighbouring runs at the same height
+    page.skyline.clear();
+    for (const skyline_t& run : skyline)
+    {
+        if (!page.skyline.empty() && page.skyline.back().y == run.y)
+            page.skyline.back().width = static_cast<uint16_t>(page.skyline.back().width + run.width);
+        else
+            page.skyline.push_back(run);
+    }
+}
+
+void CLightmapAtlas::OpenPage(uint16_t width, uint16_t height)
+{
+    page_t page;
+    page.width = width;
+    page.height = height;
+    page.usedWidth = 0;
+    page.usedHeight = 0;
+    page.skyline.push_back({ 0, 0, width });
+    m_pages.push_back(page);
+}
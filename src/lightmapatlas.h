@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "lightmapimage.h"
+
+// where one lightmap ended up in the atlas, x/y/width/height exclude the padding
+typedef struct
+{
+    uint32_t page;
+    uint16_t x;
+    uint16_t y;
+    uint16_t width;
+    uint16_t height;
+} atlasrect_t;
+
+// skyline bottom-left packer that places many small lightmaps on a few large pages. Every
+// lightmap gets a border of padding lumels copied from its edges, so bilinear filtering never
+// picks up a neighbour
+class CLightmapAtlas
+{
+public:
+
+    CLightmapAtlas(uint16_t pageSize, uint16_t padding);
+
+    // place a width x height lightmap, opening a new page when it fits on none of the open ones.
+    // Lightmaps larger than a page get a page of their own
+    atlasrect_t Insert(uint16_t width, uint16_t height);
+
+    size_t NumPages() const
+    {
+        return m_pages.size();
+    }
+
+    // pages are cropped to the area actually used
+    uint16_t GetPageWidth(uint32_t page) const
+    {
+        return m_pages[page].usedWidth;
+    }
+
+    uint16_t GetPageHeight(uint32_t page) const
+    {
+        return m_pages[page].usedHeight;
+    }
+
+    // copy each image to its rect (images[i] to rects[i]) and return one image per page
+    void BuildPages(
+            const std::vector<CLightmapImg*>& images,
+            const std::vector<atlasrect_t>& rects,
+            std::vector<CLightmapImg*>* pages) const;
+
+private:
+
+    // one run of the skyline, the top of everything placed over [x, x + width)
+    typedef struct
+    {
+        uint16_t x;
+        uint16_t y;
+        uint16_t width;
+    } skyline_t;
+
+    typedef struct
+    {
+        std::vector<skyline_t> skyline;
+        uint16_t width;
+        uint16_t height;
+        uint16_t usedWidth;
+        uint16_t usedHeight;
+    } page_t;
+
+    uint16_t m_pageSize;
+    uint16_t m_padding;
+    std::vector<page_t> m_pages;
+
+    // lowest position for a width x height rect on the page, false if there is none
+    static bool FindPosition(const page_t& page, uint16_t width, uint16_t height, uint16_t* outX, uint16_t* outY);
+
+    static void AddToSkyline(page_t& page, uint16_t x, uint16_t y, uint16_t width, uint16_t height);
+
+    void OpenPage(uint16_t width, uint16_t height);
+};
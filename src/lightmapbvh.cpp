@@ -0,0 +1,558 @@
+#include <limits>
+#include <algorithm>
+#include "lightmapbvh.h"
+#include "rmath.h"
+#include "osutils.h"
+
+namespace
+{
+    // one kernel call per leaf for polys of up to cRayKernelMaxEdges points
+    const uint32_t cMaxLeafPolys = cRayKernelWidth;
+    const int cNumBins = 8;
+    const int cMaxStackDepth = 64;
+
+    // a depth first walk never holds more than depth + 1 nodes, so capping the tree here keeps
+    // every traversal inside the fixed stacks. Nodes at the cap become leaves whatever their size
+    const uint32_t cMaxTreeDepth = cMaxStackDepth - 2;
+
+    // poly bounds are grown slightly so hits the point in poly edge tolerance accepts just outside
+    // the edges are never culled by the bounds test
+    const float cBoundsPadding = rade::math::cEpsilonLarger;
+
+    float SurfaceArea(const float* min, const float* max)
+    {
+        float ex = max[0] - min[0];
+        float ey = max[1] - min[1];
+        float ez = max[2] - min[2];
+        return ex * ey + ey * ez + ez * ex;
+    }
+}
+
+void CLightmapBVH::Clear()
+{
+    m_nodes.clear();
+    m_polyIndices.clear();
+    m_blocks.clear();
+    m_polyCache = nullptr;
+}
+
+void CLightmapBVH::Build(const CPolyCache& polyCache)
+{
+    Clear();
+    m_polyCache = &polyCache;
+
+    size_t polyCount = polyCache.Size();
+    if (polyCount == 0)
+        return;
+
+    // padded bounds and centroid for every polygon
+    std::vector<primbounds_t> bounds(polyCount);
+    for (size_t i = 0; i < polyCount; i++)
+    {
+        primbounds_t& b = bounds[i];
+        const polyrecord_t& record = polyCache.Get(i);
+        for (int axis = 0; axis < 3; axis++)
+        {
+            b.min[axis] = record.min[axis];
+            b.max[axis] = record.max[axis];
+        }
+        for (int axis = 0; axis < 3; axis++)
+        {
+            b.min[axis] -= cBoundsPadding;
+            b.max[axis] += cBoundsPadding;
+            b.center[axis] = (b.min[axis] + b.max[axis]) * 0.5f;
+        }
+    }
+
+    m_polyIndices.resize(polyCount);
+    for (uint32_t i = 0; i < m_polyIndices.size(); i++)
+        m_polyIndices[i] = i;
+
+    // a binary tree never has more than 2n-1 nodes
+    m_nodes.reserve(polyCount * 2);
+
+    node_t root{};
+    root.first = 0;
+    root.count = static_cast<uint32_t>(polyCount);
+    m_nodes.push_back(root);
+    UpdateNodeBounds(m_nodes[0], bounds);
+    Subdivide(0, bounds);
+    PackLeaves();
+}
+
+void CLightmapBVH::PackLeaves()
+{
+    m_blocks.clear();
+    m_blocks.reserve(m_polyIndices.size() / cRayKernelWidth + m_nodes.size());
+
+    for (node_t& node : m_nodes)
+    {
+        if (node.count == 0)
+            continue;
+
+        uint32_t firstBlock = static_cast<uint32_t>(m_blocks.size());
+        CRayKernel::PackPolys(*m_polyCache, &m_polyIndices[node.first], node.count, m_blocks);
+        node.first = firstBlock;
+        node.numBlocks = static_cast<uint32_t>(m_blocks.size()) - firstBlock;
+    }
+}
+
+void CLightmapBVH::UpdateNodeBounds(node_t& node, const std::vector<primbounds_t>& bounds) const
+{
+    for (int axis = 0; axis < 3; axis++)
+    {
+        node.min[axis] = std::numeric_limits<float>::max();
+        node.max[axis] = -std::numeric_limits<float>::max();
+    }
+    for (uint32_t i = node.first; i < node.first + node.count; i++)
+    {
+        const primbounds_t& b = bounds[m_polyIndices[i]];
+        for (int axis = 0; axis < 3; axis++)
+        {
+            node.min[axis] = std::min(node.min[axis], b.min[axis]);
+            node.max[axis] = std::max(node.max[axis], b.max[axis]);
+        }
+    }
+}
+
+void CLightmapBVH::Subdivide(uint32_t nodeIndex, const std::vector<primbounds_t>& bounds)
+{
+    // iterative to stay clear of the stack on very large levels
+    // node and its depth
+    std::vector<std::pair<uint32_t, uint32_t>> pending;
+    pending.push_back(std::make_pair(nodeIndex, 0u));
+
+    while (!pending.empty())
+    {
+        uint32_t current = pending.back().first;
+        uint32_t depth = pending.back().second;
+        pending.pop_back();
+
+        uint32_t first = m_nodes[current].first;
+        uint32_t count = m_nodes[current].count;
+        if (count <= cMaxLeafPolys || depth >= cMaxTreeDepth)
+            continue;
+
+        // centroid bounds decide the bin layout
+        float cMin[3];
+        float cMax[3];
+        for (int axis = 0; axis < 3; axis++)
+        {
+            cMin[axis] = std::numeric_limits<float>::max();
+            cMax[axis] = -std::numeric_limits<float>::max();
+        }
+        for (uint32_t i = first; i < first + count; i++)
+        {
+            const primbounds_t& b = bounds[m_polyIndices[i]];
+            for (int axis = 0; axis < 3; axis++)
+            {
+                cMin[axis] = std::min(cMin[axis], b.center[axis]);
+                cMax[axis] = std::max(cMax[axis], b.center[axis]);
+            }
+        }
+
+        // binned surface area heuristic
+        int bestAxis = -1;
+        int bestSplit = 0;
+        float bestCost = SurfaceArea(m_nodes[current].min, m_nodes[current].max) * static_cast<float>(count);
+
+        for (int axis = 0; axis < 3; axis++)
+        {
+            float extent = cMax[axis] - cMin[axis];
+            if (extent <= rade::math::cEpsilonSmaller)
+                continue;
+
+            struct
+            {
+                float min[3];
+                float max[3];
+                uint32_t count;
+            } bins[cNumBins];
+
+            for (auto& bin : bins)
+            {
+                for (int a = 0; a < 3; a++)
+                {
+                    bin.min[a] = std::numeric_limits<float>::max();
+                    bin.max[a] = -std::numeric_limits<float>::max();
+                }
+                bin.count = 0;
+            }
+
+            float scale = cNumBins / extent;
+            for (uint32_t i = first; i < first + count; i++)
+            {
+                const primbounds_t& b = bounds[m_polyIndices[i]];
+                int binIndex = std::min(cNumBins - 1, static_cast<int>((b.center[axis] - cMin[axis]) * scale));
+                bins[binIndex].count++;
+                for (int a = 0; a < 3; a++)
+                {
+                    bins[binIndex].min[a] = std::min(bins[binIndex].min[a], b.min[a]);
+                    bins[binIndex].max[a] = std::max(bins[binIndex].max[a], b.max[a]);
+                }
+            }
+
+            // sweep from the left and right to evaluate every split plane between bins
+            float leftArea[cNumBins - 1];
+            uint32_t leftCount[cNumBins - 1];
+            float rightArea[cNumBins - 1];
+            uint32_t rightCount[cNumBins - 1];
+
+            float accMin[3], accMax[3];
+            uint32_t accCount = 0;
+            for (int a = 0; a < 3; a++)
+            {
+                accMin[a] = std::numeric_limits<float>::max();
+                accMax[a] = -std::numeric_limits<float>::max();
+            }
+            for (int i = 0; i < cNumBins - 1; i++)
+            {
+                accCount += bins[i].count;
+                for (int a = 0; a < 3; a++)
+                {
+                    accMin[a] = std::min(accMin[a], bins[i].min[a]);
+                    accMax[a] = std::max(accMax[a], bins[i].max[a]);
+                }
+                leftCount[i] = accCount;
+                leftArea[i] = accCount ? SurfaceArea(accMin, accMax) : 0.0f;
+            }
+
+            accCount = 0;
+            for (int a = 0; a < 3; a++)
+            {
+                accMin[a] = std::numeric_limits<float>::max();
+                accMax[a] = -std::numeric_limits<float>::max();
+            }
+            for (int i = cNumBins - 1; i > 0; i--)
+            {
+                accCount += bins[i].count;
+                for (int a = 0; a < 3; a++)
+                {
+                    accMin[a] = std::min(accMin[a], bins[i].min[a]);
+                    accMax[a] = std::max(accMax[a], bins[i].max[a]);
+                }
+                rightCount[i - 1] = accCount;
+                rightArea[i - 1] = accCount ? SurfaceArea(accMin, accMax) : 0.0f;
+            }
+
+            for (int i = 0; i < cNumBins - 1; i++)
+            {
+                if (leftCount[i] == 0 || rightCount[i] == 0)
+                    continue;
+
+                float cost = leftArea[i] * static_cast<float>(leftCount[i]) +
+                             rightArea[i] * static_cast<float>(rightCount[i]);
+                if (cost < bestCost)
+                {
+                    bestCost = cost;
+                    bestAxis = axis;
+                    bestSplit = i;
+                }
+            }
+        }
+
+        uint32_t splitIndex;
+        if (bestAxis == -1)
+        {
+            // no useful SAH split (coincident centroids), fall back to halving the list
+            splitIndex = first + count / 2;
+        }
+        else
+        {
+            float scale = cNumBins / (cMax[bestAxis] - cMin[bestAxis]);
+            auto middle = std::partition(
+                    m_polyIndices.begin() + first,
+                    m_polyIndices.begin() + first + count,
+                    [&](uint32_t polyIndex)
+                    {
+                        const primbounds_t& b = bounds[polyIndex];
+                        int binIndex = std::min(cNumBins - 1,
+                                static_cast<int>((b.center[bestAxis] - cMin[bestAxis]) * scale));
+                        return binIndex <= bestSplit;
+                    });
+            splitIndex = static_cast<uint32_t>(middle - m_polyIndices.begin());
+        }
+
+        uint32_t leftIndex = static_cast<uint32_t>(m_nodes.size());
+        node_t left{};
+        left.first = first;
+        left.count = splitIndex - first;
+        node_t right{};
+        right.first = splitIndex;
+        right.count = first + count - splitIndex;
+
+        m_nodes.push_back(left);
+        m_nodes.push_back(right);
+        UpdateNodeBounds(m_nodes[leftIndex], bounds);
+        UpdateNodeBounds(m_nodes[leftIndex + 1], bounds);
+
+        m_nodes[current].first = leftIndex;
+        m_nodes[current].count = 0;
+
+        pending.push_back(std::make_pair(leftIndex, depth + 1));
+        pending.push_back(std::make_pair(leftIndex + 1, depth + 1));
+    }
+}
+
+bool CLightmapBVH::IntersectBounds(
+        const node_t& node,
+        const float* origin,
+        const float* invDir,
+        float tMax)
+{
+    float tNear = 0.0f;
+    float tFar = tMax;
+    for (int axis = 0; axis < 3; axis++)
+    {
+        float t0 = (node.min[axis] - origin[axis]) * invDir[axis];
+        float t1 = (node.max[axis] - origin[axis]) * invDir[axis];
+        if (t0 > t1)
+            std::swap(t0, t1);
+
+        // NaN (origin on the slab with a zero direction) compares false and keeps the range open
+        if (t0 > tNear) tNear = t0;
+        if (t1 < tFar) tFar = t1;
+        if (tNear > tFar)
+            return false;
+    }
+    return true;
+}
+
+bool CLightmapBVH::Traverse(const rayquery_t& query, float tMax, bool anyHit, float* distance) const
+{
+    if (m_nodes.empty())
+        return false;
+
+    // bounds are tested along the unnormalised from -> to, or the ray as given
+    const float* origin = query.origin;
+    float dir[3];
+    for (int axis = 0; axis < 3; axis++)
+        dir[axis] = query.isSegment ? query.end[axis] - origin[axis] : query.dir[axis];
+    const float invDir[3] = { 1.0f / dir[0], 1.0f / dir[1], 1.0f / dir[2] };
+
+    float dirLength = sqrtf(dir[0] * dir[0] + dir[1] * dir[1] + dir[2] * dir[2]);
+    if (dirLength <= 0.0f)
+        return false;
+
+    int splitAxis = 0;
+    float maxExtent = std::fabs(dir[0]);
+    if (std::fabs(dir[1]) > maxExtent) { splitAxis = 1; maxExtent = std::fabs(dir[1]); }
+    if (std::fabs(dir[2]) > maxExtent) { splitAxis = 2; }
+
+    bool hit = false;
+    float closest = std::numeric_limits<float>::max();
+
+    uint32_t stack[cMaxStackDepth];
+    int stackSize = 0;
+    stack[stackSize++] = 0;
+
+    while (stackSize > 0)
+    {
+        const node_t& node = m_nodes[stack[--stackSize]];
+        if (!IntersectBounds(node, origin, invDir, tMax))
+            continue;
+
+        if (node.count == 0)
+        {
+            // visit the nearer child first so the closest hit shrinks tMax early
+            const node_t& left = m_nodes[node.first];
+            const node_t& right = m_nodes[node.first + 1];
+            bool leftFirst = (left.min[splitAxis] + left.max[splitAxis]) <
+                             (right.min[splitAxis] + right.max[splitAxis]);
+            if (invDir[splitAxis] < 0.0f)
+                leftFirst = !leftFirst;
+
+            // the build caps the depth, a partial answer here would be a wrong answer
+            rade::Assert(stackSize + 2 <= cMaxStackDepth, "CLightmapBVH stack overflow, tree is too deep\n");
+            stack[stackSize++] = leftFirst ? node.first + 1 : node.first;
+            stack[stackSize++] = leftFirst ? node.first : node.first + 1;
+            continue;
+        }
+
+        for (uint32_t i = node.first; i < node.first + node.numBlocks; i++)
+        {
+            float laneDistance[cRayKernelWidth];
+            uint32_t lanesHit = CRayKernel::Intersect(m_blocks[i], query, anyHit ? nullptr : laneDistance);
+            if (lanesHit == 0)
+                continue;
+
+            if (anyHit)
+                return true;
+
+            for (int lane = 0; lane < cRayKernelWidth; lane++)
+            {
+                if (!(lanesHit & (1u << lane)) || laneDistance[lane] >= closest)
+                    continue;
+
+                closest = laneDistance[lane];
+                hit = true;
+                // only nodes nearer than this hit can improve on it
+                tMax = std::min(tMax, (closest + cBoundsPadding) / dirLength);
+            }
+        }
+    }
+
+    if (hit && distance)
+        *distance = closest;
+    return hit;
+}
+
+bool CLightmapBVH::IsSegmentOccluded(const rade::float3& from, const rade::float3& to) const
+{
+    rayquery_t query;
+    CRayKernel::SetupSegment(from, to, &query);
+    return Traverse(query, 1.0f, true, nullptr);
+}
+
+bool CLightmapBVH::GetSegmentHit(const rade::float3& from, const rade::float3& to, float* distance) const
+{
+    rayquery_t query;
+    CRayKernel::SetupSegment(from, to, &query);
+    return Traverse(query, 1.0f, false, distance);
+}
+
+bool CLightmapBVH::GetRayHit(const rade::float3& pos, const rade::float3& ray, float* distance) const
+{
+    rayquery_t query;
+    CRayKernel::SetupRay(pos, ray, &query);
+    return Traverse(query, std::numeric_limits<float>::max(), false, distance);
+}
+
+uint64_t CLightmapBVH::TraversePacket(const raypacket_t& packet, bool anyHit, float* distances) const
+{
+    uint32_t numRays = std::min(packet.numRays, cMaxPacketRays);
+    if (m_nodes.empty() || numRays == 0)
+        return 0;
+
+    // per ray setup as in Traverse
+    float invDir[cMaxPacketRays][3];
+    float dirLength[cMaxPacketRays];
+    float tMax[cMaxPacketRays];
+    float closest[cMaxPacketRays];
+    float packetDir[3] = { 0.0f, 0.0f, 0.0f };
+    uint64_t active = 0;
+
+    for (uint32_t i = 0; i < numRays; i++)
+    {
+        const rayquery_t& query = packet.rays[i];
+        float dir[3];
+        for (int axis = 0; axis < 3; axis++)
+        {
+            dir[axis] = query.isSegment ? query.end[axis] - query.origin[axis] : query.dir[axis];
+            invDir[i][axis] = 1.0f / dir[axis];
+            packetDir[axis] += dir[axis];
+        }
+        dirLength[i] = sqrtf(dir[0] * dir[0] + dir[1] * dir[1] + dir[2] * dir[2]);
+        tMax[i] = query.isSegment ? 1.0f : std::numeric_limits<float>::max();
+        closest[i] = std::numeric_limits<float>::max();
+        if (dirLength[i] > 0.0f)
+            active |= uint64_t(1) << i;
+    }
+
+    // children are ordered by the summed direction, close enough for coherent rays
+    int splitAxis = 0;
+    float maxExtent = std::fabs(packetDir[0]);
+    if (std::fabs(packetDir[1]) > maxExtent) { splitAxis = 1; maxExtent = std::fabs(packetDir[1]); }
+    if (std::fabs(packetDir[2]) > maxExtent) { splitAxis = 2; }
+
+    uint64_t hits = 0;
+
+    struct
+    {
+        uint32_t node;
+        uint64_t rays;
+    } stack[cMaxStackDepth];
+    int stackSize = 0;
+    stack[stackSize].node = 0;
+    stack[stackSize++].rays = active;
+
+    while (stackSize > 0 && active)
+    {
+        --stackSize;
+        const node_t& node = m_nodes[stack[stackSize].node];
+
+        // rays that finished (any hit) since this entry was pushed drop out here
+        uint64_t candidates = stack[stackSize].rays & active;
+        uint64_t nodeRays = 0;
+        for (uint32_t i = 0; i < numRays && candidates; i++)
+        {
+            uint64_t bit = uint64_t(1) << i;
+            if (!(candidates & bit))
+                continue;
+            candidates &= ~bit;
+            if (IntersectBounds(node, packet.rays[i].origin, invDir[i], tMax[i]))
+                nodeRays |= bit;
+        }
+        if (nodeRays == 0)
+            continue;
+
+        if (node.count == 0)
+        {
+            const node_t& left = m_nodes[node.first];
+            const node_t& right = m_nodes[node.first + 1];
+            bool leftFirst = (left.min[splitAxis] + left.max[splitAxis]) <
+                             (right.min[splitAxis] + right.max[splitAxis]);
+            if (packetDir[splitAxis] < 0.0f)
+                leftFirst = !leftFirst;
+
+            rade::Assert(stackSize + 2 <= cMaxStackDepth, "CLightmapBVH stack overflow, tree is too deep\n");
+            stack[stackSize].node = leftFirst ? node.first + 1 : node.first;
+            stack[stackSize++].rays = nodeRays;
+            stack[stackSize].node = leftFirst ? node.first : node.first + 1;
+            stack[stackSize++].rays = nodeRays;
+            continue;
+        }
+
+        for (uint32_t i = 0; i < numRays && nodeRays; i++)
+        {
+            uint64_t bit = uint64_t(1) << i;
+            if (!(nodeRays & bit))
+                continue;
+            nodeRays &= ~bit;
+
+            for (uint32_t b = node.first; b < node.first + node.numBlocks; b++)
+            {
+                float laneDistance[cRayKernelWidth];
+                uint32_t lanesHit = CRayKernel::Intersect(m_blocks[b], packet.rays[i], anyHit ? nullptr : laneDistance);
+                if (lanesHit == 0)
+                    continue;
+
+                hits |= bit;
+                if (anyHit)
+                {
+                    active &= ~bit;
+                    break;
+                }
+
+                for (int lane = 0; lane < cRayKernelWidth; lane++)
+                {
+                    if (!(lanesHit & (1u << lane)) || laneDistance[lane] >= closest[i])
+                        continue;
+
+                    closest[i] = laneDistance[lane];
+                    tMax[i] = std::min(tMax[i], (closest[i] + cBoundsPadding) / dirLength[i]);
+                }
+            }
+        }
+    }
+
+    if (distances)
+    {
+        for (uint32_t i = 0; i < numRays; i++)
+        {
+            if (hits & (uint64_t(1) << i))
+                distances[i] = closest[i];
+        }
+    }
+    return hits;
+}
+
+uint64_t CLightmapBVH::GetPacketOccluded(const raypacket_t& packet) const
+{
+    return TraversePacket(packet, true, nullptr);
+}
+
+uint64_t CLightmapBVH::GetPacketHits(const raypacket_t& packet, float* distances) const
+{
+    return TraversePacket(packet, false, distances);
+}
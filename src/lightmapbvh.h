@@ -0,0 +1,79 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include "point3d.h"
+#include "polycache.h"
+#include "raykernel.h"
+
+// bounding volume hierarchy over the lightmap generator polygon records, built once per bake and
+// shared read-only by all worker threads. Leaves hold packed polyblock_t ranges that are tested
+// a full block at a time by CRayKernel
+class CLightmapBVH
+{
+public:
+
+    void Build(const CPolyCache& polyCache);
+
+    void Clear();
+
+    bool IsBuilt() const
+    {
+        return !m_nodes.empty();
+    }
+
+    // true if the segment from -> to crosses any polygon
+    bool IsSegmentOccluded(const rade::float3& from, const rade::float3& to) const;
+
+    // closest polygon crossed by the segment, distance is measured from "from"
+    bool GetSegmentHit(const rade::float3& from, const rade::float3& to, float* distance) const;
+
+    // closest polygon hit by the ray, distance is measured from "pos"
+    bool GetRayHit(const rade::float3& pos, const rade::float3& ray, float* distance) const;
+
+    // packet versions of the queries above, traversing the tree once for all rays. Bit i of the
+    // result is set if packet.rays[i] is occluded or hit something
+    uint64_t GetPacketOccluded(const raypacket_t& packet) const;
+
+    // distances[i] receives the closest hit distance for every ray that hit
+    uint64_t GetPacketHits(const raypacket_t& packet, float* distances) const;
+
+private:
+
+    typedef struct
+    {
+        float min[3];
+        float max[3];
+        uint32_t first;     // first child node, or first entry in m_blocks for leaves
+        uint32_t count;     // number of polys, 0 for interior nodes
+        uint32_t numBlocks;
+    } node_t;
+
+    typedef struct
+    {
+        float min[3];
+        float max[3];
+        float center[3];
+    } primbounds_t;
+
+    std::vector<node_t> m_nodes;
+    std::vector<uint32_t> m_polyIndices;
+    std::vector<polyblock_t> m_blocks;
+    const CPolyCache* m_polyCache = nullptr;
+
+    void Subdivide(uint32_t nodeIndex, const std::vector<primbounds_t>& bounds);
+
+    void UpdateNodeBounds(node_t& node, const std::vector<primbounds_t>& bounds) const;
+
+    void PackLeaves();
+
+    static bool IntersectBounds(
+            const node_t& node,
+            const float* origin,
+            const float* invDir,
+            float tMax);
+
+    bool Traverse(const rayquery_t& query, float tMax, bool anyHit, float* distance) const;
+
+    uint64_t TraversePacket(const raypacket_t& packet, bool anyHit, float* distances) const;
+};
@@ -1,3 +1,4 @@
+#include <cfloat>
 #include <cstring>
 #include <thread>
 #include <chrono>
@@ -8,145 +9,111 @@
 #include "image.h"
 #include "rmath.h"
 #include "osutils.h"
-
-CLightmapGen::shpheremap_t* CLightmapGen::GetSphereRaysForNormal(const rade::vector3& normal)
+#include "timer.h"
+#include "taskscheduler.h"
+#include "sampler.h"
+#include "lightmapatlas.h"
+#include "lightmapcodec.h"
+#include "allocators.h"
+#include "blur.h"
+
+namespace
 {
-    for (auto& m_sphere : m_spheres)
-    {
-        if (m_sphere->normal == normal)
-        {
-            return m_sphere;
-        }
-    }
-
-    auto* newMap = new CLightmapGen::shpheremap_t;
-    newMap->normal = normal;
+    // lumels per side of the square tiles a lightmap is split into, so one large poly can be
+    // spread over every worker
+    const int cLightmapTileSize = 16;
 
-    for (int i = 0; i < m_options.numSphereRays; i++)
-    {
-        rade::vector3 rayPoint;
-        GenerateHemisphereRay(normal, &rayPoint);
-        rayPoint.Scale(m_options.sphereSize);
-        newMap->rays.push_back(rayPoint);
-    }
-
-    m_spheres.push_back(newMap);
-    return m_spheres.at(m_spheres.size() - 1);
+    // lumels repeated around each lightmap on an atlas page so filtering does not bleed
+    const uint16_t cAtlasPadding = 2;
 }
 
-void CLightmapGen::GenerateHemisphereRay(
-        const rade::vector3& normal,
-        rade::vector3* ret)
+const sphererays_t* CLightmapGen::GetSphereRaysForNormal(const rade::float3& normal)
 {
-    while (true)
+    return m_spheres.Get(normal, [this](const rade::float3& n, const int32_t* key, std::vector<rade::float3>& rays)
     {
-        rade::vector3 p;
-        p.x = rade::math::RandomFloat(-1, 1);
-        p.y = rade::math::RandomFloat(-1, 1);
-        p.z = rade::math::RandomFloat(-1, 1);
-
-        // reject ones outside unit sphere
-        if (p.x * p.x + p.y * p.y + p.z * p.z > 0.9999) continue;
-
-        if (p.Dot(normal) < 0.001) continue;  // ignore "down" dirs (below the surface)
-
-        p.Normalize();
-
-        ret->x = p.x;
-        ret->y = p.y;
-        ret->z = p.z;
-        return;
-    }
+        // seeded from the bake seed and the quantised normal only, so a bake is reproducible
+        // whatever the thread count or the order the polys are processed in
+        rade::Random random(rade::sampling::HashSeed(static_cast<uint32_t>(m_options.seed), key, 3));
+        rade::sampling::GenerateHemisphere(n, m_options.numSphereRays,
+                static_cast<rade::sampling::ESampleMode>(m_options.samplingMode), random, rays);
+
+        for (rade::float3& rayPoint : rays)
+            rayPoint.Scale(m_options.sphereSize);
+    });
 }
 
 bool CLightmapGen::DoesLineIntersectWithPolyList(
-        const rade::vector3& lightPos,
-        const rade::vector3& lumelPos,
-        const std::vector<rade::poly3d>& polyList)
+        const rade::float3& lightPos,
+        const rade::float3& lumelPos) const
 {
-    int count = 0;
+    if (m_options.useBVH)
+    {
+        return m_bvh.IsSegmentOccluded(lightPos, lumelPos);
+    }
 
-    for (const rade::poly3d& poly : polyList)
+    for (size_t i = 0; i < m_polyCache.Size(); i++)
     {
-        count++;
-        //rade::plane3d plane(poly);
-        rade::plane3d plane = poly.GetPlane();
-        // does this line cross the plane at any point
-        rade::math::ESide lightSide = plane.ClassifyPoint(lightPos);
-        rade::math::ESide lumelSide = plane.ClassifyPoint(lumelPos);
-        if (lightSide != lumelSide)
-        {
-            rade::vector3 hitPos;
-            if (plane.GetRayIntersect(lightPos, lumelPos, &hitPos))
-            {
-                if (poly.PointInPoly(hitPos))
-                    return true;
-            }
-        }
+        rade::float3 hitPos;
+        if (m_polyCache.SegmentHitsPoly(m_polyCache.Get(i), lightPos, lumelPos, &hitPos))
+            return true;
     }
     return false;
 }
 
 bool CLightmapGen::DoesLineIntersectWithPolyList(
-        const rade::vector3& lightPos,
-        const rade::vector3& lumelPos,
-        const std::vector<rade::poly3d>& polyList,
-        float* distance)
+        const rade::float3& lightPos,
+        const rade::float3& lumelPos,
+        float* distance) const
 {
-    int count = 0;
-    for (const rade::poly3d& poly: polyList)
+    if (m_options.useBVH)
     {
-        count++;
-        rade::plane3d plane = poly.GetPlane();
+        return m_bvh.GetSegmentHit(lightPos, lumelPos, distance);
+    }
 
-        // does this line cross the plane at any point
-        rade::math::ESide lightSide = plane.ClassifyPoint(lightPos);
-        rade::math::ESide lumelSide = plane.ClassifyPoint(lumelPos);
-        if (lightSide != lumelSide)
+    // closest hit, so the brute force path can be used to validate the BVH
+    bool hit = false;
+    for (size_t i = 0; i < m_polyCache.Size(); i++)
+    {
+        rade::float3 hitPos;
+        if (m_polyCache.SegmentHitsPoly(m_polyCache.Get(i), lightPos, lumelPos, &hitPos))
         {
-            rade::vector3 hitPos;
-            if (plane.GetRayIntersect(lightPos, lumelPos, &hitPos))
-            {
-                if (poly.PointInPoly(hitPos))
-                {
-                    *distance = hitPos.Distance(lightPos);
-                    return true;
-                }
-            }
+            float hitDistance = hitPos.Distance(lightPos);
+            if (!hit || hitDistance < *distance)
+                *distance = hitDistance;
+            hit = true;
         }
     }
-    return false;
+    return hit;
 }
 
 bool CLightmapGen::DoesRayIntersectWithPolyList(
-        const rade::vector3& pos,
-        const rade::vector3& ray,
-        const std::vector<rade::poly3d>& polyList,
-        float* distance)
+        const rade::float3& pos,
+        const rade::float3& ray,
+        float* distance) const
 {
-    int count = 0;
-    for (const rade::poly3d& poly: polyList)
+    if (m_options.useBVH)
     {
-        count++;
-        rade::plane3d plane = poly.GetPlane();
+        return m_bvh.GetRayHit(pos, ray, distance);
+    }
 
-        // does this line cross the plane at any point
-        rade::vector3 hitPos;
-        if (plane.GetRayIntersection(pos, ray, &hitPos))
+    bool hit = false;
+    for (size_t i = 0; i < m_polyCache.Size(); i++)
+    {
+        rade::float3 hitPos;
+        if (m_polyCache.RayHitsPoly(m_polyCache.Get(i), pos, ray, &hitPos))
         {
-            if (poly.PointInPoly(hitPos))
-            {
-                *distance = hitPos.Distance(pos);
-                return true;
-            }
+            float hitDistance = hitPos.Distance(pos);
+            if (!hit || hitDistance < *distance)
+                *distance = hitDistance;
+            hit = true;
         }
     }
-    return false;
+    return hit;
 }
 
-void CLightmapGen::CalcEdgeVectors(const rade::plane3d& plane, const float* uvMin, const float* uvMax, rade::vector3& edge1,
-        rade::vector3& edge2,
-        rade::vector3& UVVector)
+void CLightmapGen::CalcEdgeVectors(const rade::plane3d& plane, const float* uvMin, const float* uvMax, rade::float3& edge1,
+        rade::float3& edge2,
+        rade::float3& UVVector)
 {
     float Distance = plane.GetDistance();
     const rade::vector3& normal = plane.GetNormal();
@@ -156,7 +123,7 @@ void CLightmapGen::CalcEdgeVectors(const rade::plane3d& plane, const float* uvMi
     float Max_U = uvMax[0];
     float Max_V = uvMax[1];
 
-    rade::vector3 vect1, vect2;
+    rade::float3 vect1, vect2;
     float X, Y, Z;
 
     // calc the missing uv vector based on plane equation
@@ -293,58 +260,113 @@ void CLightmapGen::CalcLightmapUV(std::vector<rade::vector3>& polyPoints, rade::
     }
 }
 
-bool CLightmapGen::GetSunFactor(
-        rade::poly3d* poly,
-        rade::vector3* lumelPos,
-        const rade::vector3& sunColor,
-        const rade::vector3& sunDir,
-        std::vector<rade::poly3d>& polyList,
-        rade::vector3* outColor)
+rade::float3 CLightmapGen::GetSunPosition(const rade::float3& lumelPos, const rade::float3& sunDir)
 {
-    bool dataModified = false;
-    rade::plane3d plane = poly->GetPlane();
-    rade::vector3 lightVectorFwd = (*lumelPos + sunDir) - *lumelPos;
-    //rade::vector3 lightVectorBack = *lumelPos - (*lumelPos + sunDir);
+    rade::float3 lightVectorFwd = (lumelPos + sunDir) - lumelPos;
     lightVectorFwd.Normalize();
 
-    float distance = 0.0f;
-
-    rade::vector3 fakeSunPos = *lumelPos + (lightVectorFwd * 1000);
-    fakeSunPos = fakeSunPos * 2;
+    rade::float3 fakeSunPos = lumelPos + (lightVectorFwd * 1000);
+    return fakeSunPos * 2;
+}
 
+void CLightmapGen::GetSunOcclusion(
+        const rade::float3* lumelPositions,
+        size_t numLumels,
+        const rade::float3& sunDir,
+        uint8_t* occluded) const
+{
     // TODO: this should be changed, needs a ray cast not a line segment test
-    if (!DoesLineIntersectWithPolyList(fakeSunPos, *lumelPos, polyList))
-    //if(DoesRayIntersectWithPolyList(*lumelPos, lightVectorBack, polyList, &distance))
+    if (m_options.useBVH && m_options.usePackets)
+    {
+        raypacket_t packet;
+        for (size_t first = 0; first < numLumels; first += cMaxPacketRays)
+        {
+            packet.numRays = static_cast<uint32_t>(std::min<size_t>(cMaxPacketRays, numLumels - first));
+            for (uint32_t i = 0; i < packet.numRays; i++)
+            {
+                const rade::float3& lumelPos = lumelPositions[first + i];
+                CRayKernel::SetupSegment(GetSunPosition(lumelPos, sunDir), lumelPos, &packet.rays[i]);
+            }
+
+            uint64_t hits = m_bvh.GetPacketOccluded(packet);
+            for (uint32_t i = 0; i < packet.numRays; i++)
+                occluded[first + i] = (hits >> i) & 1;
+        }
+        return;
+    }
+
+    for (size_t i = 0; i < numLumels; i++)
     {
-        outColor->Set(outColor->x + sunColor.x / 2, outColor->y + sunColor.y /2, outColor->z + sunColor.z /2);
+        const rade::float3& lumelPos = lumelPositions[i];
+        occluded[i] = DoesLineIntersectWithPolyList(GetSunPosition(lumelPos, sunDir), lumelPos);
+    }
+}
+
+bool CLightmapGen::GetSunFactor(
+        bool sunOccluded,
+        const rade::float3& sunColor,
+        rade::float3* outColor)
+{
+    bool dataModified = false;
+    if (!sunOccluded)
+    {
+        *outColor = rade::float3(outColor->x + sunColor.x / 2, outColor->y + sunColor.y / 2, outColor->z + sunColor.z / 2);
         dataModified = true;
     }
-    if (outColor->x > 254) outColor->x = 254;
-    if (outColor->y > 254) outColor->y = 254;
-    if (outColor->z > 254) outColor->z = 254;
+    if (!m_options.hdr)
+    {
+        if (outColor->x > 254) outColor->x = 254;
+        if (outColor->y > 254) outColor->y = 254;
+        if (outColor->z > 254) outColor->z = 254;
+    }
     return dataModified;
 }
 
 bool CLightmapGen::GetAmbientFactor(
-        rade::poly3d* poly,
-        rade::vector3* lumelPos,
-        const std::vector<rade::Light>& lights,
-        std::vector<rade::poly3d>& polyList,
-        rade::vector3* outColor)
+        const polyrecord_t& polyRecord,
+        const rade::float3& lumelPos,
+        rade::float3* outColor)
 {
-    rade::plane3d plane = poly->GetPlane();
-    shpheremap_t* sphere = GetSphereRaysForNormal(plane.GetNormal());
+    const sphererays_t* sphere = GetSphereRaysForNormal(rade::float3(polyRecord.normal));
 
     int numhits = 0;
     float avgDist = 0;
-    for (uint16_t i = 0; i < m_options.numSphereRays; i++)
+    if (m_options.useBVH && m_options.usePackets)
     {
-        rade::vector3 testPos = (*lumelPos + sphere->rays.at(i));
-        float distance = 0;
-        if (DoesLineIntersectWithPolyList(testPos, *lumelPos, polyList, &distance))
+        // all sphere rays share the lumel end point, so they stay together through the tree
+        raypacket_t packet;
+        float distances[cMaxPacketRays];
+        for (int first = 0; first < m_options.numSphereRays; first += cMaxPacketRays)
         {
-            numhits++;
-            avgDist += distance;
+            packet.numRays = std::min(cMaxPacketRays, static_cast<uint32_t>(m_options.numSphereRays - first));
+            for (uint32_t i = 0; i < packet.numRays; i++)
+            {
+                rade::float3 testPos = lumelPos + sphere->rays[first + i];
+                CRayKernel::SetupSegment(testPos, lumelPos, &packet.rays[i]);
+            }
+
+            uint64_t hits = m_bvh.GetPacketHits(packet, distances);
+            for (uint32_t i = 0; i < packet.numRays; i++)
+            {
+                if (hits & (uint64_t(1) << i))
+                {
+                    numhits++;
+                    avgDist += distances[i];
+                }
+            }
+        }
+    }
+    else
+    {
+        for (uint16_t i = 0; i < m_options.numSphereRays; i++)
+        {
+            rade::float3 testPos = lumelPos + sphere->rays[i];
+            float distance = 0;
+            if (DoesLineIntersectWithPolyList(testPos, lumelPos, &distance))
+            {
+                numhits++;
+                avgDist += distance;
+            }
         }
     }
     avgDist /= (m_options.numSphereRays);
@@ -360,9 +382,12 @@ bool CLightmapGen::GetAmbientFactor(
     outColor->y = outColor->y - shadeAmt;
     outColor->z = outColor->z - shadeAmt;
 
-    if (outColor->x > 254) outColor->x = 254;
-    if (outColor->y > 254) outColor->y = 254;
-    if (outColor->z > 254) outColor->z = 254;
+    if (!m_options.hdr)
+    {
+        if (outColor->x > 254) outColor->x = 254;
+        if (outColor->y > 254) outColor->y = 254;
+        if (outColor->z > 254) outColor->z = 254;
+    }
 
     if (outColor->x < 0) outColor->x = 0;
     if (outColor->y < 0) outColor->y = 0;
@@ -373,37 +398,34 @@ bool CLightmapGen::GetAmbientFactor(
 }
 
 bool CLightmapGen::GetShadowFactor(
-        rade::poly3d* poly,
-        rade::vector3* lumelPos,
+        const polyrecord_t& polyRecord,
+        const rade::float3& lumelPos,
         const std::vector<rade::Light>& lights,
-        std::vector<rade::poly3d>& polyList,
-        rade::vector3* outColor)
+        rade::float3* outColor)
 {
     bool dataModified = false;
 
-    rade::plane3d plane = poly->GetPlane();
-
     for (auto& light :lights)
     {
-        rade::vector3 lightVector = *lumelPos - light.pos;
-        lightVector.Normalize();
-        float distanceFromLightToLumel = light.pos.Distance(*lumelPos);
+        rade::float3 lightPos(light.pos);
+        float distanceFromLightToLumel = lightPos.Distance(lumelPos);
         float radius = light.radius;
 
         if (distanceFromLightToLumel < radius)
         {
-            if (plane.ClassifyPoint(light.pos) == rade::math::ESide_FRONT)
+            if (CPolyCache::ClassifyPoint(polyRecord, lightPos) == rade::math::ESide_FRONT)
             {
                 // do a ray test on this vector with the polyset, if it doesnt intersect
                 // set the light, otherwise leave it at "m_options.shadowUnlit" colour
-                if (!DoesLineIntersectWithPolyList(light.pos, *lumelPos, polyList))
+                if (!DoesLineIntersectWithPolyList(lightPos, lumelPos))
                 {
                     float intensity = (radius / distanceFromLightToLumel) - 1.0f;
                     float r = (light.color[0] * light.brightness) * intensity;
                     float g = (light.color[1] * light.brightness) * intensity;
                     float b = (light.color[2] * light.brightness) * intensity;
 
-                    outColor->Set(std::min(outColor->x + r, 255.0f), std::min(outColor->y + g, 255.0f), std::min(outColor->z + b, 255.0f));
+                    float maxColor = m_options.hdr ? FLT_MAX : 255.0f;
+                    *outColor = rade::float3(std::min(outColor->x + r, maxColor), std::min(outColor->y + g, maxColor), std::min(outColor->z + b, maxColor));
                     dataModified = true;
                 }
             }
@@ -412,9 +434,7 @@ bool CLightmapGen::GetShadowFactor(
     return dataModified;
 }
 
-int CLightmapGen::GenerateLightmap(rade::poly3d* poly, std::vector<rade::poly3d>& polyList,
-        const std::vector<rade::Light>& lights,
-        CLightmapImg* lightmap)
+void CLightmapGen::PrepareLightmap(rade::poly3d* poly, lightmapjob_t& job)
 {
     rade::plane3d plane = poly->GetPlane();
     std::vector<rade::vector3>& polyPoints = poly->GetPointListRef();
@@ -433,33 +453,77 @@ int CLightmapGen::GenerateLightmap(rade::poly3d* poly, std::vector<rade::poly3d>
     lightmapWidth = static_cast<uint16_t>(lightmapWidth * m_options.lmDetail);
     lightmapHeight = static_cast<uint16_t>(lightmapHeight * m_options.lmDetail);
 
-    lightmap->Allocate(lightmapWidth, lightmapHeight);
+    job.lightmap->Allocate(lightmapWidth, lightmapHeight);
 
     // calculate the edge vectors to interpolate over later
-    rade::vector3 edge1, edge2, UVVector;
-    CalcEdgeVectors(plane, uvMin, uvMax, edge1, edge2, UVVector);
+    CalcEdgeVectors(plane, uvMin, uvMax, job.edge1, job.edge2, job.UVVector);
 
     // now that we have the two edge vectors, we can find the lumel positions in world space by
     // interpolating along these edges using the width and height of the lightmap
-    LumelData lumelData(lightmapWidth, lightmapHeight);
+    job.lumelData.reset(new LumelData(lightmapWidth, lightmapHeight));
+    job.width = lightmapWidth;
+    job.height = lightmapHeight;
+    job.dataModified = false;
+}
+
+void CLightmapGen::GenerateLightmapTile(
+        const polyrecord_t& polyRecord,
+        const std::vector<rade::Light>& lights,
+        lightmapjob_t& job,
+        int tileX,
+        int tileY)
+{
+    LumelData& lumelData = *job.lumelData;
+    int lightmapWidth = job.width;
+    int lightmapHeight = job.height;
+
+    int startX = tileX * cLightmapTileSize;
+    int startY = tileY * cLightmapTileSize;
+    int endX = std::min(startX + cLightmapTileSize, lightmapWidth);
+    int endY = std::min(startY + cLightmapTileSize, lightmapHeight);
 
     bool dataModified = false;
 
-    for (int iX = 0; iX < lightmapWidth; iX++)
+    // a column of the tile at a time, so the sun rays of the column can be traced together
+    rade::float3 columnPositions[cLightmapTileSize];
+    uint8_t sunOccluded[cLightmapTileSize] = {};
+    rade::float3 sunDir(m_options.sunDir);
+    rade::float3 sunColour(m_options.sunColour);
+
+    float lumelSize = std::max(sqrtf(job.edge1.Dot(job.edge1)) / lightmapWidth,
+            sqrtf(job.edge2.Dot(job.edge2)) / lightmapHeight) * 1.5f;
+
+    for (int iX = startX; iX < endX; iX++)
     {
-        for (int iY = 0; iY < lightmapHeight; iY++)
+        for (int iY = startY; iY < endY; iY++)
         {
             float ufactor = ((float)iX / (float)lightmapWidth) + 0.0025f;
             float vfactor = ((float)iY / (float)lightmapHeight) + 0.0025f;
 
-            rade::vector3 newedge1, newedge2;
-            newedge1 = edge1 * ufactor;
-            newedge2 = edge2 * vfactor;
-            lumelData.SetPosition(iX, iY, UVVector + newedge2 + newedge1);
+            rade::float3 newedge1 = job.edge1 * ufactor;
+            rade::float3 newedge2 = job.edge2 * vfactor;
+            columnPositions[iY - startY] = job.UVVector + newedge2 + newedge1;
+            lumelData.SetPosition(iX, iY, columnPositions[iY - startY]);
+
+            // a lumel counts as on the poly if any part of it could be, so edges still blend
+            if (m_options.blurMask)
+            {
+                lumelData.m_mask[lumelData.index(iX, iY)] =
+                        m_polyCache.PointInPoly(polyRecord, columnPositions[iY - startY], lumelSize) ? 1 : 0;
+            }
+        }
+
+        if (m_options.createSun)
+        {
+            GetSunOcclusion(columnPositions, endY - startY, sunDir, sunOccluded);
+            m_raysTraced += endY - startY;
+        }
 
-            rade::vector3* lumelPos = lumelData.GetPosition(iX, iY);
+        for (int iY = startY; iY < endY; iY++)
+        {
+            const rade::float3& lumelPos = columnPositions[iY - startY];
 
-            rade::vector3 finalColour((float)m_options.shadowUnlit, (float)m_options.shadowUnlit,
+            rade::float3 finalColour((float)m_options.shadowUnlit, (float)m_options.shadowUnlit,
                     (float)m_options.shadowUnlit);
 
             bool hasShadows = false;
@@ -467,13 +531,16 @@ int CLightmapGen::GenerateLightmap(rade::poly3d* poly, std::vector<rade::poly3d>
             bool hasAmbient = false;
 
             if(m_options.createShadows)
-                hasShadows = GetShadowFactor(poly, lumelPos, lights, polyList, &finalColour);
+                hasShadows = GetShadowFactor(polyRecord, lumelPos, lights, &finalColour);
 
             if(m_options.createSun)
-                hasSun = GetSunFactor(poly, lumelPos, rade::vector3(m_options.sunColour), rade::vector3(m_options.sunDir), polyList, &finalColour);
+                hasSun = GetSunFactor(sunOccluded[iY - startY] != 0, sunColour, &finalColour);
 
             if(m_options.createAO)
-                hasAmbient = GetAmbientFactor(poly, lumelPos, lights, polyList, &finalColour);
+            {
+                hasAmbient = GetAmbientFactor(polyRecord, lumelPos, &finalColour);
+                m_raysTraced += m_options.numSphereRays;
+            }
 
             if(hasAmbient || hasShadows || hasSun)
                 dataModified = true;
@@ -483,27 +550,62 @@ int CLightmapGen::GenerateLightmap(rade::poly3d* poly, std::vector<rade::poly3d>
     }
 
     if (dataModified)
+        job.dataModified = true;
+}
+
+bool CLightmapGen::FinishLightmap(lightmapjob_t& job)
+{
+    CLightmapImg* lightmap = job.lightmap;
+    LumelData& lumelData = *job.lumelData;
+    uint16_t lightmapWidth = job.width;
+    uint16_t lightmapHeight = job.height;
+    bool dataModified = job.dataModified;
+
+    // blur buffers come from this worker's arena and are gone again when the lightmap is done
+    rade::ScratchArena& arena = rade::ScratchArena::ForThread();
+    rade::ScratchScope scratchScope(arena);
+    auto blurKernel = static_cast<rade::blur::EKernel>(m_options.blurKernel);
+    const uint8_t* blurMask = m_options.blurMask ? lumelData.m_mask : nullptr;
+
+    if (dataModified && m_options.hdr)
     {
+        // blur in float, then encode, RGBM lumels cannot be averaged
+        auto* scratch = arena.AllocateArray<float>(static_cast<size_t>(lightmapWidth) * lightmapHeight);
+        for (int i = 0; i < m_options.postBlur; i++)
+        {
+            for (float* plane : { lumelData.m_colorR, lumelData.m_colorG, lumelData.m_colorB })
+            {
+                rade::blur::BlurPlane(plane, scratch, lightmapWidth, lightmapHeight, blurKernel,
+                        m_options.blurRadius, blurMask);
+            }
+        }
+
         for (int iX = 0; iX < lightmapWidth; iX++)
         {
             for (int iY = 0; iY < lightmapHeight; iY++)
             {
-                lightmap->SetPixel(iX, iY, *lumelData.GetColor(iX, iY));
+                rade::float3 color = lumelData.GetColor(iX, iY);
+                rade::EncodeRGBM(&color.x, lightmap->GetPixel(iX, iY));
+            }
+        }
+        lightmap->m_encoding = rade::ELightmapEncoding_RGBM;
+    }
+    else if (dataModified)
+    {
+        for (int iX = 0; iX < lightmapWidth; iX++)
+        {
+            for (int iY = 0; iY < lightmapHeight; iY++)
+            {
+                lightmap->SetPixel(iX, iY, lumelData.GetColor(iX, iY));
             }
         }
 
-        rade::Image bm(lightmapWidth, lightmapHeight, rade::Image::Format_RGBA, lightmap->m_data);
+        auto* scratch = arena.AllocateArray<unsigned char>(lightmap->GetDataSize());
         for (int i = 0; i < m_options.postBlur; i++)
-            bm.Blur();
-
-//        static int counter = 0;
-//        char fname[128];
-//        sprintf(fname, "smooth%d.png", counter);
-//        counter++;
-//        bm.SavePNG(fname);
-
-        unsigned char* pixBuff = bm.GetPixelBuffer();
-        memcpy(lightmap->m_data, pixBuff, lightmapWidth * lightmapHeight * 4);
+        {
+            rade::blur::BlurRGBA(lightmap->m_data, scratch, lightmapWidth, lightmapHeight, blurKernel,
+                    m_options.blurRadius, blurMask);
+        }
     }
     else
     {
@@ -511,7 +613,7 @@ int CLightmapGen::GenerateLightmap(rade::poly3d* poly, std::vector<rade::poly3d>
         {
             for (int iY = 0; iY < lightmapHeight; iY++)
             {
-                rade::vector3 p((float)m_options.shadowUnlit, (float)m_options.shadowUnlit,
+                rade::float3 p((float)m_options.shadowUnlit, (float)m_options.shadowUnlit,
                         (float)m_options.shadowUnlit);
                 lightmap->SetPixel(iX, iY, p);
             }
@@ -520,6 +622,71 @@ int CLightmapGen::GenerateLightmap(rade::poly3d* poly, std::vector<rade::poly3d>
     return dataModified;
 }
 
+void CLightmapGen::ReportPacketGain()
+{
+    // AO rays from the centre of (up to) the first 256 polys, traced both ways
+    const size_t cSamplePolys = 256;
+    size_t numSamples = std::min(cSamplePolys, m_polyCache.Size());
+    if (numSamples == 0 || m_options.numSphereRays <= 0)
+        return;
+
+    std::vector<rade::float3> centers(numSamples);
+    std::vector<const sphererays_t*> spheres(numSamples);
+    for (size_t i = 0; i < numSamples; i++)
+    {
+        const polyrecord_t& record = m_polyCache.Get(i);
+        const float* points = m_polyCache.GetPoints(record);
+        rade::float3 center;
+        for (uint16_t p = 0; p < record.numPoints; p++)
+            center = center + rade::float3(&points[p * 3]);
+        centers[i] = center * (1.0f / static_cast<float>(record.numPoints));
+        spheres[i] = GetSphereRaysForNormal(rade::float3(record.normal));
+    }
+
+    uint64_t numRays = static_cast<uint64_t>(numSamples) * m_options.numSphereRays;
+    uint64_t singleHits = 0;
+    uint64_t packetHits = 0;
+
+    rade::timer singleTimer;
+    for (size_t s = 0; s < numSamples; s++)
+    {
+        for (int i = 0; i < m_options.numSphereRays; i++)
+        {
+            float distance;
+            if (m_bvh.GetSegmentHit(centers[s] + spheres[s]->rays[i], centers[s], &distance))
+                singleHits++;
+        }
+    }
+    float singleTime = singleTimer.ElapsedTime();
+
+    rade::timer packetTimer;
+    raypacket_t packet;
+    float distances[cMaxPacketRays];
+    for (size_t s = 0; s < numSamples; s++)
+    {
+        for (int first = 0; first < m_options.numSphereRays; first += cMaxPacketRays)
+        {
+            packet.numRays = std::min(cMaxPacketRays, static_cast<uint32_t>(m_options.numSphereRays - first));
+            for (uint32_t i = 0; i < packet.numRays; i++)
+                CRayKernel::SetupSegment(centers[s] + spheres[s]->rays[first + i], centers[s], &packet.rays[i]);
+
+            uint64_t hits = m_bvh.GetPacketHits(packet, distances);
+            for (uint32_t i = 0; i < packet.numRays; i++)
+                packetHits += (hits >> i) & 1;
+        }
+    }
+    float packetTime = packetTimer.ElapsedTime();
+
+    if (singleHits != packetHits)
+        rade::Log("Ray packet mismatch, %llu single hits, %llu packet hits\n",
+                static_cast<unsigned long long>(singleHits), static_cast<unsigned long long>(packetHits));
+
+    float singleRate = singleTime > 0.0f ? numRays / singleTime : 0.0f;
+    float packetRate = packetTime > 0.0f ? numRays / packetTime : 0.0f;
+    rade::Log("AO rays: %.0f rays/sec single, %.0f rays/sec packets (%.2fx)\n",
+            singleRate, packetRate, singleRate > 0.0f ? packetRate / singleRate : 0.0f);
+}
+
 void CLightmapGen::GenerateLMData(unsigned char val, CLightmapImg& lm)
 {
     lm.Allocate(32, 32);
@@ -531,59 +698,165 @@ void CLightmapGen::GenerateLMData(unsigned char val, CLightmapImg& lm)
             lm.SetPixel(iX, iY, p);
         }
     }
+
+    if (m_options.hdr)
+    {
+        float rgb[3] = { static_cast<float>(val), static_cast<float>(val), static_cast<float>(val) };
+        for (int iX = 0; iX < lm.m_width; iX++)
+        {
+            for (int iY = 0; iY < lm.m_height; iY++)
+                rade::EncodeRGBM(rgb, lm.GetPixel(iX, iY));
+        }
+        lm.m_encoding = rade::ELightmapEncoding_RGBM;
+    }
 }
 
-int CLightmapGen::GenerateLightMapDataRange(
+void CLightmapGen::GenerateLightmapForPoly(
         std::vector<rade::poly3d>& polyList,
         const std::vector<rade::Light>& lights,
-        threaddata_t* threadData)
+        size_t polyIndex)
 {
-    for (unsigned int i = threadData->startIndex; i < threadData->endIndex; i++)
+    std::shared_ptr<lightmapjob_t> job(new lightmapjob_t);
+    job->polyIndex = polyIndex;
+    job->lightmap = new CLightmapImg();
+    PrepareLightmap(&polyList.at(polyIndex), *job);
+
+    const polyrecord_t& polyRecord = m_polyCache.Get(polyIndex);
+    int tilesX = (job->width + cLightmapTileSize - 1) / cLightmapTileSize;
+    int tilesY = (job->height + cLightmapTileSize - 1) / cLightmapTileSize;
+    int numTiles = tilesX * tilesY;
+
+    if (numTiles <= 1 || !m_scheduler)
     {
-        rade::poly3d& poly = polyList.at(i);
-        auto* lm = new CLightmapImg();
-        bool hasShadows = GenerateLightmap(&poly, polyList, lights, lm);
+        for (int tileY = 0; tileY < tilesY; tileY++)
+        {
+            for (int tileX = 0; tileX < tilesX; tileX++)
+                GenerateLightmapTile(polyRecord, lights, *job, tileX, tileY);
+        }
+        CompleteLightmap(polyList, *job);
+        return;
+    }
 
-        if (hasShadows)
+    // every lumel only depends on its own position, so the tiles can run on any worker in any
+    // order. The last tile to finish blurs and stores the lightmap
+    job->tilesRemaining = static_cast<uint32_t>(numTiles);
+    for (int tileY = 0; tileY < tilesY; tileY++)
+    {
+        for (int tileX = 0; tileX < tilesX; tileX++)
         {
-            m_lmMutex.lock();
-            // copy the ptr to the shared list, get an index and quickly get out of here
-            m_lightMapList.emplace_back(lm);
-            uint32_t lmIndex = static_cast<uint32_t>(m_lightMapList.size()) - 1;
-            m_lmMutex.unlock();
-            poly.SetLightmapDataIndex(lmIndex);
+            m_scheduler->Submit([this, job, &polyList, &lights, &polyRecord, tileX, tileY]
+            {
+                GenerateLightmapTile(polyRecord, lights, *job, tileX, tileY);
+                if (--job->tilesRemaining == 0)
+                    CompleteLightmap(polyList, *job);
+            });
         }
-        else
+    }
+}
+
+void CLightmapGen::CompleteLightmap(std::vector<rade::poly3d>& polyList, lightmapjob_t& job)
+{
+    rade::poly3d& poly = polyList.at(job.polyIndex);
+    CLightmapImg* lm = job.lightmap;
+    bool hasShadows = FinishLightmap(job);
+    job.lumelData.reset();
+
+    if (hasShadows)
+    {
+        m_lmMutex.lock();
+        // copy the ptr to the shared list, get an index and quickly get out of here
+        m_lightMapList.emplace_back(lm);
+        uint32_t lmIndex = static_cast<uint32_t>(m_lightMapList.size()) - 1;
+        m_lmMutex.unlock();
+        poly.SetLightmapDataIndex(lmIndex);
+    }
+    else
+    {
+        poly.SetLightmapDataIndex(0);
+        delete lm;
+    }
+    job.lightmap = nullptr;
+    m_completedPolys++;
+}
+
+void CLightmapGen::PackAtlas(std::vector<rade::poly3d>& polyList)
+{
+    // the list is in the order the polys finished, which depends on the threads. Order by size
+    // and then by the poly using the lightmap so the same bake always packs the same atlas
+    size_t numLightmaps = m_lightMapList.size();
+    std::vector<size_t> owner(numLightmaps, 0);
+    for (size_t i = 0; i < polyList.size(); i++)
+    {
+        uint32_t lmIndex = polyList[i].GetLightmapDataIndex();
+        if (lmIndex != 0)
+            owner[lmIndex] = i + 1;
+    }
+
+    std::vector<uint32_t> order(numLightmaps);
+    for (uint32_t i = 0; i < numLightmaps; i++)
+        order[i] = i;
+    std::sort(order.begin(), order.end(), [this, &owner](uint32_t a, uint32_t b)
+    {
+        const CLightmapImg* lmA = m_lightMapList[a];
+        const CLightmapImg* lmB = m_lightMapList[b];
+        if (lmA->m_height != lmB->m_height)
+            return lmA->m_height > lmB->m_height;
+        if (lmA->m_width != lmB->m_width)
+            return lmA->m_width > lmB->m_width;
+        return owner[a] < owner[b];
+    });
+
+    CLightmapAtlas atlas(static_cast<uint16_t>(std::min(m_options.atlasSize, 8192)), cAtlasPadding);
+    std::vector<atlasrect_t> rects(numLightmaps);
+    for (uint32_t lmIndex : order)
+        rects[lmIndex] = atlas.Insert(m_lightMapList[lmIndex]->m_width, m_lightMapList[lmIndex]->m_height);
+
+    std::vector<CLightmapImg*> pages;
+    atlas.BuildPages(m_lightMapList, rects, &pages);
+    for (CLightmapImg* page : pages)
+        page->m_encoding = m_lightMapList[0]->m_encoding;
+
+    // lightmap UVs are 0-1 over the poly's own lightmap, move them onto its rect on the page
+    for (rade::poly3d& poly : polyList)
+    {
+        const atlasrect_t& rect = rects[poly.GetLightmapDataIndex()];
+        float pageWidth = atlas.GetPageWidth(rect.page);
+        float pageHeight = atlas.GetPageHeight(rect.page);
+        for (rade::vector3& point : poly.GetPointListRef())
         {
-            poly.SetLightmapDataIndex(0);
-            delete lm;
+            point.lmU = (rect.x + point.lmU * rect.width) / pageWidth;
+            point.lmV = (rect.y + point.lmV * rect.height) / pageHeight;
         }
-        threadData->completedItems++;
+        poly.SetLightmapDataIndex(rect.page);
     }
-    return 0;
+
+    rade::Log("Packed %u lightmaps onto %u atlas pages\n",
+            static_cast<unsigned int>(numLightmaps), static_cast<unsigned int>(pages.size()));
+
+    for (CLightmapImg* lm : m_lightMapList)
+        delete lm;
+    m_lightMapList = pages;
 }
 
-void CLightmapGen::ThreadWorkerLightmapRange(
-        std::vector<rade::poly3d>* polyList,
-        const std::vector<rade::Light>* lights,
-        threaddata_t* threadData)
+float CLightmapGen::EstimateLightmapCost(const polyrecord_t& polyRecord) const
 {
-    GenerateLightMapDataRange(*polyList, *lights, threadData);
+    // lumel count of the lightmap GenerateLightmap will allocate, from the bounds on the
+    // two axes of the planar mapping
+    int uAxis = polyRecord.axis == rade::plane3d::EPlaneAxis_YZ ? 1 : 0;
+    int vAxis = polyRecord.axis == rade::plane3d::EPlaneAxis_XY ? 1 : 2;
+    float width = (polyRecord.max[uAxis] - polyRecord.min[uAxis]) * m_options.lmDetail;
+    float height = (polyRecord.max[vAxis] - polyRecord.min[vAxis]) * m_options.lmDetail;
+    return width * height;
 }
 
-void CLightmapGen::ThreadStatusUpdate(
-        threaddata_t* threadData,
-        uint16_t numThreads,
-        uint16_t totalItems)
+void CLightmapGen::ThreadStatusUpdate(uint32_t totalItems)
 {
     bool complete = false;
-    uint16_t totalDone;
+    uint32_t totalDone;
     do
     {
         std::this_thread::sleep_for(std::chrono::milliseconds(300));
-        totalDone = 0;
-        for (uint16_t i = 0; i < numThreads; i++)
-            totalDone += threadData[i].completedItems;
+        totalDone = m_completedPolys;
 
         float pctComplete = static_cast<float>(totalDone) / static_cast<float>(totalItems) * 100;
         //PrintProgress(pctComplete);
@@ -607,56 +880,83 @@ int CLightmapGen::Generate(
     // copy options
     m_options = lampOptions;
 
-    uint16_t processor_count = std::thread::hardware_concurrency();
-    if (processor_count == 0)
-    {
-        processor_count = 1;
-    }
+    // FOR SANE DEBUGGING set numThreads to 1
+    rade::TaskScheduler scheduler(static_cast<unsigned int>(std::max(0, m_options.numThreads)));
+    rade::Log("Spawning %u threads\n", scheduler.NumThreads());
+
+    auto polyCount = static_cast<unsigned int>(polyList.size());
 
-    // FOR SANE DEBUGGING
-    //processor_count = 1;
+    // planes, bounds and points for every poly, shared read-only by the worker threads. The poly
+    // points are rewritten with lightmap UVs during the bake, but positions never change
+    m_polyCache.Build(polyList);
 
-    threaddata_t threadData[/*processor_count*/ 128];
-    rade::Log("Spawning %i threads\n", processor_count);
+    // AO ray sets, at most one per distinct poly normal
+    m_spheres.Reset(polyCount);
 
-    auto polyCount = static_cast<unsigned int>(polyList.size());
-    unsigned int range = polyCount / processor_count;
+    // acceleration structure for all occlusion queries, the poly list is not resized during the bake
+    if (m_options.useBVH)
+    {
+        rade::timer bvhTimer;
+        m_bvh.Build(m_polyCache);
+        rade::Log("BVH built for %u polys in %.3f seconds\n", polyCount, bvhTimer.ElapsedTime());
+    }
+
+    m_lightMapList.clear();
 
     // generate simple black lightmap to use for all polys that have no lights affecting them
     auto* lmBlack = new CLightmapImg();
     GenerateLMData(m_options.shadowUnlit, *lmBlack);
     m_lightMapList.push_back(lmBlack);
 
-    std::vector<std::thread> workers;
-    for (int i = 0; i < processor_count; i++)
-    {
-        threadData[i].startIndex = i * range;
-        threadData[i].endIndex = threadData[i].startIndex + range;
-
-        // if last thread, process to end of list (rounding due to divide of items/num threads)
-        bool isLastRange = (i + 1 == processor_count);
-        if (isLastRange)
-        {
-            threadData[i].endIndex = polyCount;
-        }
-        threadData[i].completedItems = 0;
+    m_raysTraced = 0;
+    rade::timer bakeTimer;
 
-        workers.emplace_back(&CLightmapGen::ThreadWorkerLightmapRange,
-                this, &polyList, &lights, &threadData[i]);
+    // one task per poly, biggest lightmaps first so the long ones are not left until the end.
+    // Idle workers steal from the others, so the split no longer decides the bake time
+    std::vector<uint32_t> order(polyCount);
+    std::vector<float> cost(polyCount);
+    for (uint32_t i = 0; i < polyCount; i++)
+    {
+        order[i] = i;
+        cost[i] = EstimateLightmapCost(m_polyCache.Get(i));
     }
+    std::stable_sort(order.begin(), order.end(), [&cost](uint32_t a, uint32_t b) { return cost[a] > cost[b]; });
 
-    std::thread statusThread(&CLightmapGen::ThreadStatusUpdate, this,
-            &threadData[0], processor_count, polyCount);
-
-    for (std::thread& t: workers)
+    m_completedPolys = 0;
+    m_scheduler = &scheduler;
+    for (uint32_t polyIndex : order)
     {
-        if (t.joinable())
-            t.join();
+        scheduler.Submit([this, &polyList, &lights, polyIndex]
+        {
+            GenerateLightmapForPoly(polyList, lights, polyIndex);
+        });
     }
+
+    std::thread statusThread(&CLightmapGen::ThreadStatusUpdate, this, polyCount);
+    scheduler.Wait();
+    m_scheduler = nullptr;
+    float bakeTime = bakeTimer.ElapsedTime();
     statusThread.join();
 
-    for (auto sphere : m_spheres)
-        delete sphere;
+    uint64_t raysTraced = m_raysTraced;
+    rade::Log("Baked %u polys in %.3f seconds, %llu AO/sun rays (%.0f rays/sec%s)\n",
+            polyCount, bakeTime, static_cast<unsigned long long>(raysTraced),
+            bakeTime > 0.0f ? raysTraced / bakeTime : 0.0f,
+            (m_options.useBVH && m_options.usePackets) ? ", packets" : "");
+
+    if (m_options.reportPacketGain && m_options.useBVH && m_options.usePackets && m_options.createAO)
+        ReportPacketGain();
+
+    if (m_options.atlasSize > 0)
+        PackAtlas(polyList);
+
+    m_spheres.Clear();
+
+    m_bvh.Clear();
+    m_polyCache.Clear();
+
+    // the per poly lightmaps and lumel buffers freed during the bake are still pooled
+    rade::BlockPool::Get().Trim();
 
     // copy the pointers to the returned list
     for (auto& j : m_lightMapList)
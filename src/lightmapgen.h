@@ -1,6 +1,8 @@
 #pragma once
 
 #include <mutex>
+#include <atomic>
+#include <memory>
 #include <vector>
 #include <functional>
 #include "polygon3d.h"
@@ -8,10 +10,14 @@
 #include "lightmapimage.h"
 #include "lumeldata.h"
 #include "light3d.h"
+#include "lightmapbvh.h"
+#include "polycache.h"
+#include "sphereraycache.h"
 
 namespace rade
 {
     class textmesh;
+    class TaskScheduler;
 };
 
 namespace NRadeLamp
@@ -27,18 +33,20 @@ class CLightmapGen
 private:
 
 
+    // one poly's lightmap while its tiles are being generated
     typedef struct
     {
-        unsigned int startIndex;
-        unsigned int endIndex;
-        uint16_t completedItems;
-    } threaddata_t;
-
-    typedef struct
-    {
-        rade::vector3 normal;
-        std::vector<rade::vector3> rays;
-    } shpheremap_t;
+        size_t polyIndex;
+        CLightmapImg* lightmap;
+        std::unique_ptr<LumelData> lumelData;
+        rade::float3 edge1;
+        rade::float3 edge2;
+        rade::float3 UVVector;
+        uint16_t width;
+        uint16_t height;
+        std::atomic<uint32_t> tilesRemaining;
+        std::atomic<bool> dataModified;
+    } lightmapjob_t;
 
 public:
 
@@ -55,6 +63,17 @@ public:
         bool createSun;
         float sunColour[3];
         float sunDir[3];
+        bool useBVH;
+        bool usePackets;
+        int numThreads;
+        int seed;
+        int samplingMode;   // rade::sampling::ESampleMode
+        int atlasSize;      // lightmap atlas page size, 0 = one lightmap per poly
+        bool hdr;           // keep light above full white, lightmaps are stored RGBM
+        int blurRadius;     // post blur taps either side, up to rade::blur::cMaxRadius
+        int blurKernel;     // rade::blur::EKernel
+        bool blurMask;      // only blur lumels inside the poly
+        bool reportPacketGain;  // after the bake, time a sample of AO rays single and as packets
     } lmoptions_t;
 
     // generate lightmaps
@@ -64,6 +83,12 @@ public:
             const std::vector<rade::Light>& lights,
             std::vector<CLightmapImg*>* lightMapList);
 
+    // the options of the last Generate() call, or the defaults
+    const lmoptions_t& GetOptions() const
+    {
+        return m_options;
+    }
+
     // register status callback
     void RegisterCallback(const cb_t& cb)
     {
@@ -98,35 +123,50 @@ protected:
             1,      // blur
             true,   // genereate sun
             { 0.2f, 0.2f, 0.6f },  // sun colour
-            { 0.1f, 0.6f, 0.3f }   // sun dir
+            { 0.1f, 0.6f, 0.3f },  // sun dir
+            true,   // use BVH for occlusion queries (false = brute force, for validation)
+            true,   // trace AO and sun rays as packets through the BVH
+            0,      // worker threads, 0 = one per hardware thread
+            0,      // seed for the AO ray sets
+            2,      // AO sampling, rade::sampling::ESampleMode_Hammersley
+            1024,   // atlas page size in lumels, 0 = one texture per poly
+            false,  // HDR (RGBM) lightmaps
+            1,      // post blur radius
+            1,      // post blur kernel, rade::blur::EKernel_Gaussian
+            false,  // post blur lumels outside the poly too
+            false   // packet benchmark after the bake
     };
 
     std::mutex m_lmMutex;
 
-    std::vector<shpheremap_t*> m_spheres;
+    // AO ray set per surface normal, shared lock-free by the worker threads
+    CSphereRayCache m_spheres;
 
-    shpheremap_t* GetSphereRaysForNormal(const rade::vector3& normal);
+    const sphererays_t* GetSphereRaysForNormal(const rade::float3& normal);
 
-    static void GenerateHemisphereRay(const rade::vector3& normal, rade::vector3* ret);
+    // built once per Generate() over the poly list, queried by all worker threads
+    CPolyCache m_polyCache;
+    CLightmapBVH m_bvh;
 
-    static bool DoesLineIntersectWithPolyList(
-            const rade::vector3& lightPos,
-            const rade::vector3& lumelPos,
-            const std::vector<rade::poly3d>& polyList);
+    // AO and sun rays traced, for the bake report
+    std::atomic<uint64_t> m_raysTraced{0};
 
     bool DoesLineIntersectWithPolyList(
-            const rade::vector3& lightPos,
-            const rade::vector3& lumelPos,
-            const std::vector<rade::poly3d>& polyList,
-            float* distance);
+            const rade::float3& lightPos,
+            const rade::float3& lumelPos) const;
+
+    bool DoesLineIntersectWithPolyList(
+            const rade::float3& lightPos,
+            const rade::float3& lumelPos,
+            float* distance) const;
 
     void CalcEdgeVectors(
             const rade::plane3d& plane,
             const float* uvMin,
             const float* uvMax,
-            rade::vector3& edge1,
-            rade::vector3& edge2,
-            rade::vector3& UVVector);
+            rade::float3& edge1,
+            rade::float3& edge2,
+            rade::float3& UVVector);
 
     void NormalizeLightmapUVs(
             std::vector<rade::vector3>& polyPoints,
@@ -139,49 +179,72 @@ protected:
 
     void GenerateLMData(unsigned char val, CLightmapImg& lm);
 
-    int GenerateLightMapDataRange(
+    // task run by the scheduler for one poly
+    void GenerateLightmapForPoly(
             std::vector<rade::poly3d>& polyList,
             const std::vector<rade::Light>& lights,
-            threaddata_t* threadData);
+            size_t polyIndex);
+
+    // approximate lumel count of a poly's lightmap, used to queue the biggest first
+    float EstimateLightmapCost(const polyrecord_t& polyRecord) const;
 
-    void ThreadWorkerLightmapRange(
-            std::vector<rade::poly3d>* polyList,
-            const std::vector<rade::Light>* lights,
-            threaddata_t* threadData);
+    void ThreadStatusUpdate(uint32_t totalItems);
 
-    void ThreadStatusUpdate(threaddata_t* threadData, uint16_t numThreads, uint16_t totalItems);
+    std::atomic<uint32_t> m_completedPolys{0};
+
+    // scheduler of the running Generate() call, for queueing tiles
+    rade::TaskScheduler* m_scheduler = nullptr;
 
     bool GetShadowFactor(
-            rade::poly3d* poly,
-            rade::vector3* lumelPos,
+            const polyrecord_t& polyRecord,
+            const rade::float3& lumelPos,
             const std::vector<rade::Light>& lights,
-            std::vector<rade::poly3d>& polyList,
-            rade::vector3* color);
+            rade::float3* color);
 
     bool GetAmbientFactor(
-            rade::poly3d* poly,
-            rade::vector3* lumelPos,
-            const std::vector<rade::Light>& lights,
-            std::vector<rade::poly3d>& polyList,
-            rade::vector3* outColor);
+            const polyrecord_t& polyRecord,
+            const rade::float3& lumelPos,
+            rade::float3* outColor);
 
     bool GetSunFactor(
-            rade::poly3d* poly,
-            rade::vector3* lumelPos,
-            const rade::vector3& sunColor,
-            const rade::vector3& sunDir,
-            std::vector<rade::poly3d>& polyList,
-            rade::vector3* outColor);
+            bool sunOccluded,
+            const rade::float3& sunColor,
+            rade::float3* outColor);
 
-    int GenerateLightmap(rade::poly3d* poly,
-            std::vector<rade::poly3d>& polyList,
+    // sun visibility for a run of lumels, traced as packets when enabled
+    void GetSunOcclusion(
+            const rade::float3* lumelPositions,
+            size_t numLumels,
+            const rade::float3& sunDir,
+            uint8_t* occluded) const;
+
+    static rade::float3 GetSunPosition(const rade::float3& lumelPos, const rade::float3& sunDir);
+
+    // times the AO rays of a sample of lumels single and as packets, logs the rays per second
+    void ReportPacketGain();
+
+    // planar UVs, lightmap size and lumel storage for a poly
+    void PrepareLightmap(rade::poly3d* poly, lightmapjob_t& job);
+
+    // lighting for one cLightmapTileSize square of lumels
+    void GenerateLightmapTile(
+            const polyrecord_t& polyRecord,
             const std::vector<rade::Light>& lights,
-            CLightmapImg* lightmap);
+            lightmapjob_t& job,
+            int tileX,
+            int tileY);
+
+    // copy and blur the lumels into the lightmap once every tile is done
+    bool FinishLightmap(lightmapjob_t& job);
+
+    void CompleteLightmap(std::vector<rade::poly3d>& polyList, lightmapjob_t& job);
+
+    // pack the poly lightmaps onto atlas pages and remap the poly lightmap UVs to match
+    void PackAtlas(std::vector<rade::poly3d>& polyList);
 
     bool DoesRayIntersectWithPolyList(
-            const rade::vector3& pos,
-            const rade::vector3& ray,
-            const std::vector<rade::poly3d>& polyList,
-            float* distance);
+            const rade::float3& pos,
+            const rade::float3& ray,
+            float* distance) const;
 };
 
@@ -1,8 +1,11 @@
 #pragma once
 
 #include "point3d.h"
+#include "float3.h"
+#include "allocators.h"
 #include <cstdint>
 #include <cstring>
+#include <vector>
 
 class CLightmapImg
 {
@@ -31,6 +34,10 @@ public:
     uint16_t m_height = 0;
     unsigned char* m_data = nullptr;
     uint16_t m_numCombines = 1;
+    uint8_t m_encoding = 0;     // rade::ELightmapEncoding of m_data
+
+    // BC1 blocks when loaded from a BC1 rbmesh, for a compressed upload. Empty otherwise
+    std::vector<unsigned char> m_bc1Blocks;
 
     size_t index(int x, int y) const
     {
@@ -60,6 +67,15 @@ public:
         m_data[offset + 3] = 255;
     }
 
+    void SetPixel(int x, int y, const rade::float3& p)
+    {
+        size_t offset = index(x, y);
+        m_data[offset + 0] = static_cast<unsigned char>(p.x);
+        m_data[offset + 1] = static_cast<unsigned char>(p.y);
+        m_data[offset + 2] = static_cast<unsigned char>(p.z);
+        m_data[offset + 3] = 255;
+    }
+
     void SetPixel(int x, int y, unsigned char r, unsigned char g, unsigned char b)
     {
         size_t offset = index(x, y);
@@ -71,14 +87,19 @@ public:
 
     void Allocate(uint16_t width, uint16_t height)
     {
+        Free();
         m_width = width;
         m_height = height;
-        if (m_data)
-            free(m_data);
 
-        //m_data = new unsigned char[width * height * 4]{};
-        m_data = (unsigned char*)malloc(sizeof(unsigned char) * width * height * 4);
-        memset(m_data, '\0', sizeof(unsigned char) * width * height * 4);
+        // lightmaps come and go by the thousand in a bake, so they are taken from the block pool
+        size_t size = GetDataSize();
+        m_data = static_cast<unsigned char*>(rade::BlockPool::Get().Allocate(size));
+        memset(m_data, '\0', size);
+    }
+
+    size_t GetDataSize() const
+    {
+        return static_cast<size_t>(m_width) * m_height * 4;
     }
 
     void Combine(CLightmapImg& lmOther)
@@ -126,7 +147,7 @@ private:
     {
         if (m_data)
         {
-            free(m_data);
+            rade::BlockPool::Get().Free(m_data, GetDataSize());
             m_data = nullptr;
         }
     }
@@ -1,7 +1,12 @@
 #pragma once
 
-#include "point3d.h"
+#include <cstdint>
+#include <cstring>
+#include "float3.h"
+#include "allocators.h"
 
+// working lumel positions and colours of one lightmap, stored as one array per component
+// (24 bytes a lumel plus a mask byte) rather than two rade::vector3 arrays
 class LumelData
 {
 public:
@@ -15,8 +20,16 @@ public:
         Free();
     }
 
-    rade::vector3* m_color;
-    rade::vector3* m_pos;
+    LumelData(const LumelData&) = delete;
+    LumelData& operator=(const LumelData&) = delete;
+
+    float* m_posX = nullptr;
+    float* m_posY = nullptr;
+    float* m_posZ = nullptr;
+    float* m_colorR = nullptr;
+    float* m_colorG = nullptr;
+    float* m_colorB = nullptr;
+    uint8_t* m_mask = nullptr;      // non zero where the lumel is on the poly
     int m_width;
     int m_height;
 
@@ -25,24 +38,37 @@ public:
         return x + m_width * y;
     }
 
-    void SetPosition(int x, int y, const rade::vector3& pos)
+    void SetPosition(int x, int y, const rade::float3& pos)
+    {
+        size_t i = index(x, y);
+        m_posX[i] = pos.x;
+        m_posY[i] = pos.y;
+        m_posZ[i] = pos.z;
+    }
+
+    rade::float3 GetPosition(int x, int y) const
     {
-        m_pos[index(x, y)] = pos;
+        size_t i = index(x, y);
+        return { m_posX[i], m_posY[i], m_posZ[i] };
     }
 
-    rade::vector3* GetPosition(uint16_t x, uint16_t y)
+    void SetColor(int x, int y, const rade::float3& color)
     {
-        return &m_pos[index(x, y)];
+        size_t i = index(x, y);
+        m_colorR[i] = color.x;
+        m_colorG[i] = color.y;
+        m_colorB[i] = color.z;
     }
 
-    rade::vector3* GetColor(uint16_t x, uint16_t y)
+    rade::float3 GetColor(int x, int y) const
     {
-        return &m_color[index(x, y)];
+        size_t i = index(x, y);
+        return { m_colorR[i], m_colorG[i], m_colorB[i] };
     }
 
-    void SetColor(uint16_t x, uint16_t y, const rade::vector3& color)
+    size_t GetDataSize() const
     {
-        m_color[index(x, y)] = color;
+        return static_cast<size_t>(m_width) * m_height * (6 * sizeof(float) + 1);
     }
 
     void Allocate(uint16_t width, uint16_t height)
@@ -50,13 +76,23 @@ public:
         m_width = width;
         m_height = height;
 
-        m_color = new rade::vector3[width * height]{};
-        m_pos = new rade::vector3[width * height]{};
+        // one block for all six components and the mask, from the block pool as they only live for one poly
+        size_t count = static_cast<size_t>(width) * height;
+        m_posX = static_cast<float*>(rade::BlockPool::Get().Allocate(GetDataSize()));
+        memset(m_posX, 0, GetDataSize());
+        m_posY = m_posX + count;
+        m_posZ = m_posY + count;
+        m_colorR = m_posZ + count;
+        m_colorG = m_colorR + count;
+        m_colorB = m_colorG + count;
+        m_mask = reinterpret_cast<uint8_t*>(m_colorB + count);
     }
 
     void Free()
     {
-        delete[] m_color;
-        delete[] m_pos;
+        rade::BlockPool::Get().Free(m_posX, GetDataSize());
+        m_posX = m_posY = m_posZ = nullptr;
+        m_colorR = m_colorG = m_colorB = nullptr;
+        m_mask = nullptr;
     }
 };
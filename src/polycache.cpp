@@ -0,0 +1,234 @@
+#include <limits>
+#include <algorithm>
+#include "polycache.h"
+#include "rmath.h"
+
+void CPolyCache::Clear()
+{
+    m_records.clear();
+    m_points.clear();
+    m_edges.clear();
+}
+
+void CPolyCache::Build(const std::vector<rade::poly3d>& polyList)
+{
+    Clear();
+    m_records.reserve(polyList.size());
+
+    size_t totalPoints = 0;
+    for (const rade::poly3d& poly : polyList)
+        totalPoints += poly.NumPoints();
+    m_points.reserve(totalPoints * 3);
+    m_edges.reserve(totalPoints * 3);
+
+    for (const rade::poly3d& poly : polyList)
+    {
+        polyrecord_t record{};
+
+        // the plane is built exactly as poly3d::GetPlane() does, so cached results match
+        rade::plane3d plane = poly.GetPlane();
+        rade::vector3 normal = plane.GetNormal();
+        record.normal[0] = normal.x;
+        record.normal[1] = normal.y;
+        record.normal[2] = normal.z;
+        record.dist = plane.GetDistance();
+        record.axis = static_cast<uint8_t>(plane.GetPlaneAxis());
+
+        record.firstPoint = static_cast<uint32_t>(m_points.size() / 3);
+        record.numPoints = static_cast<uint16_t>(poly.NumPoints());
+
+        for (int axis = 0; axis < 3; axis++)
+        {
+            record.min[axis] = std::numeric_limits<float>::max();
+            record.max[axis] = -std::numeric_limits<float>::max();
+        }
+
+        for (const rade::vector3& p : poly.GetPointListRefConst())
+        {
+            const float pos[3] = { p.x, p.y, p.z };
+            for (int axis = 0; axis < 3; axis++)
+            {
+                m_points.push_back(pos[axis]);
+                record.min[axis] = std::min(record.min[axis], pos[axis]);
+                record.max[axis] = std::max(record.max[axis], pos[axis]);
+            }
+        }
+        BuildEdges(record);
+        m_records.push_back(record);
+    }
+}
+
+void CPolyCache::BuildEdges(const polyrecord_t& record)
+{
+    size_t firstEdge = m_edges.size();
+    m_edges.resize(firstEdge + record.numPoints * 3);
+    BuildEdgeEquations(record.axis, GetPoints(record), record.numPoints, &m_edges[firstEdge]);
+}
+
+void CPolyCache::BuildEdgeEquations(uint8_t axis, const float* points, uint16_t numPoints, float* outEdges)
+{
+    // projected points and signed area, the winding in the projection depends on the normal
+    std::vector<float> u(numPoints);
+    std::vector<float> v(numPoints);
+    for (uint16_t i = 0; i < numPoints; i++)
+    {
+        ProjectPoint(axis, points[i * 3], points[i * 3 + 1], points[i * 3 + 2], &u[i], &v[i]);
+    }
+
+    float area = 0.0f;
+    for (uint16_t i = 0; i < numPoints; i++)
+    {
+        uint16_t next = (i + 1) % numPoints;
+        area += u[i] * v[next] - u[next] * v[i];
+    }
+    float orientation = area < 0.0f ? -1.0f : 1.0f;
+
+    for (uint16_t i = 0; i < numPoints; i++)
+    {
+        uint16_t next = (i + 1) % numPoints;
+        float a = -(v[next] - v[i]) * orientation;
+        float b = (u[next] - u[i]) * orientation;
+
+        // normalised so the tolerance is a distance, degenerate edges never reject a point
+        float length = sqrtf(a * a + b * b);
+        if (length > 0.0f)
+        {
+            a /= length;
+            b /= length;
+        }
+        outEdges[i * 3] = a;
+        outEdges[i * 3 + 1] = b;
+        outEdges[i * 3 + 2] = -(a * u[i] + b * v[i]);
+    }
+}
+
+rade::math::ESide CPolyCache::ClassifyPoint(const polyrecord_t& record, const rade::float3& point)
+{
+    const float* n = record.normal;
+    float p = n[0] * point.x + n[1] * point.y + n[2] * point.z + record.dist;
+    if (p < -rade::math::cEpsilon)
+    {
+        return rade::math::ESide_BACK;
+    }
+    else if (p > rade::math::cEpsilon)
+    {
+        return rade::math::ESide_FRONT;
+    }
+    return rade::math::ESide_ON;
+}
+
+bool CPolyCache::GetRayIntersect(
+        const polyrecord_t& record,
+        const rade::float3& p1,
+        const rade::float3& p2,
+        rade::float3* intersect)
+{
+    const float* n = record.normal;
+
+    float rx = p2.x - p1.x;
+    float ry = p2.y - p1.y;
+    float rz = p2.z - p1.z;
+    float length = sqrtf(rx * rx + ry * ry + rz * rz);
+    if (length > 0.0f)
+    {
+        float ilength = 1 / length;
+        rx *= ilength;
+        ry *= ilength;
+        rz *= ilength;
+    }
+
+    float dot_norm_ray = n[0] * rx + n[1] * ry + n[2] * rz;
+
+    // early out if ray is opposite direction
+    if (dot_norm_ray <= rade::math::cEpsilon)
+        return false;
+
+    float t = -((n[0] * p1.x + n[1] * p1.y + n[2] * p1.z) + record.dist) / dot_norm_ray;
+    if (fabs(t) > rade::math::cEpsilonLarger)
+    {
+        *intersect = rade::float3(p1.x + (rx * t),
+                p1.y + (ry * t),
+                p1.z + (rz * t));
+        return true;
+    }
+    return false;
+}
+
+bool CPolyCache::GetRayIntersection(
+        const polyrecord_t& record,
+        const rade::float3& point,
+        const rade::float3& ray,
+        rade::float3* intersect)
+{
+    const float* n = record.normal;
+    float dot_norm_ray = n[0] * ray.x + n[1] * ray.y + n[2] * ray.z;
+
+    // early out if ray is opposite direction
+    if (dot_norm_ray <= rade::math::cEpsilon)
+        return false;
+
+    float t = -((n[0] * point.x + n[1] * point.y + n[2] * point.z) + record.dist) / dot_norm_ray;
+    if (t > rade::math::cEpsilon)
+    {
+        if (intersect)
+        {
+            *intersect = rade::float3(point.x + (ray.x * t),
+                    point.y + (ray.y * t),
+                    point.z + (ray.z * t));
+        }
+        return true;
+    }
+    return false;
+}
+
+bool CPolyCache::PointInPoly(const polyrecord_t& record, const rade::float3& p) const
+{
+    return PointInPoly(record, p, cPolyEdgeTolerance);
+}
+
+bool CPolyCache::PointInPoly(const polyrecord_t& record, const rade::float3& p, float tolerance) const
+{
+    float u, v;
+    ProjectPoint(record.axis, p.x, p.y, p.z, &u, &v);
+
+    const float* edges = GetEdges(record);
+    for (uint16_t i = 0; i < record.numPoints; i++)
+    {
+        const float* edge = &edges[i * 3];
+        if (edge[0] * u + edge[1] * v + edge[2] < -tolerance)
+            return false;
+    }
+    return true;
+}
+
+bool CPolyCache::SegmentHitsPoly(
+        const polyrecord_t& record,
+        const rade::float3& from,
+        const rade::float3& to,
+        rade::float3* hitPos) const
+{
+    // does this line cross the plane at any point
+    if (ClassifyPoint(record, from) != ClassifyPoint(record, to))
+    {
+        if (GetRayIntersect(record, from, to, hitPos))
+        {
+            if (PointInPoly(record, *hitPos))
+                return true;
+        }
+    }
+    return false;
+}
+
+bool CPolyCache::RayHitsPoly(
+        const polyrecord_t& record,
+        const rade::float3& pos,
+        const rade::float3& ray,
+        rade::float3* hitPos) const
+{
+    if (GetRayIntersection(record, pos, ray, hitPos))
+    {
+        if (PointInPoly(record, *hitPos))
+            return true;
+    }
+    return false;
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include "polygon3d.h"
+#include "plane3d.h"
+#include "float3.h"
+
+// distance (in the projected plane) a hit may lie outside an edge and still count as inside,
+// covers float error on shared edges without the leaks of the old angle sum tolerance
+const float cPolyEdgeTolerance = rade::math::cEpsilon;
+
+// compact per polygon intersection record. Built once before a bake from the poly list and
+// shared read-only by all worker threads, so the plane is not rebuilt per poly per ray
+typedef struct
+{
+    float normal[3];
+    float dist;
+    float min[3];
+    float max[3];
+    uint32_t firstPoint;    // index of the first point/edge in CPolyCache::GetPoints()/GetEdges()
+    uint16_t numPoints;
+    uint8_t axis;           // rade::plane3d::EPlaneAxis
+} polyrecord_t;
+
+class CPolyCache
+{
+public:
+
+    void Build(const std::vector<rade::poly3d>& polyList);
+
+    void Clear();
+
+    size_t Size() const
+    {
+        return m_records.size();
+    }
+
+    const polyrecord_t& Get(size_t index) const
+    {
+        return m_records[index];
+    }
+
+    // xyz triplets, numPoints per record starting at record.firstPoint
+    const float* GetPoints(const polyrecord_t& record) const
+    {
+        return &m_points[record.firstPoint * 3];
+    }
+
+    // 2D edge equations (a, b, c) in the plane of record.axis, one per point. a*u + b*v + c is the
+    // distance to the edge in the projected plane, positive on the inside
+    const float* GetEdges(const polyrecord_t& record) const
+    {
+        return &m_edges[record.firstPoint * 3];
+    }
+
+    // plane3d::ClassifyPoint on the cached plane
+    static rade::math::ESide ClassifyPoint(const polyrecord_t& record, const rade::float3& point);
+
+    // plane3d::GetRayIntersect (segment from p1 towards p2) on the cached plane
+    static bool GetRayIntersect(
+            const polyrecord_t& record,
+            const rade::float3& p1,
+            const rade::float3& p2,
+            rade::float3* intersect);
+
+    // plane3d::GetRayIntersection (point + ray) on the cached plane
+    static bool GetRayIntersection(
+            const polyrecord_t& record,
+            const rade::float3& point,
+            const rade::float3& ray,
+            rade::float3* intersect);
+
+    // convex point in poly test. Projects onto the dominant axis and checks the precomputed
+    // edge equations, replaces the acosf angle sum of poly3d::PointInPoly in the bake
+    bool PointInPoly(const polyrecord_t& record, const rade::float3& p) const;
+
+    // as above, with the edges pushed out by tolerance
+    bool PointInPoly(const polyrecord_t& record, const rade::float3& p, float tolerance) const;
+
+    // normalised 2D edge equations for a convex loop of xyz points, 3 floats per point into outEdges
+    static void BuildEdgeEquations(uint8_t axis, const float* points, uint16_t numPoints, float* outEdges);
+
+    // the 2D (u, v) coordinates of a point projected along the dominant axis
+    static void ProjectPoint(uint8_t axis, float x, float y, float z, float* u, float* v)
+    {
+        switch (axis)
+        {
+        case rade::plane3d::EPlaneAxis_YZ:
+            *u = y;
+            *v = z;
+            break;
+
+        case rade::plane3d::EPlaneAxis_XZ:
+            *u = x;
+            *v = z;
+            break;
+
+        default:
+            *u = x;
+            *v = y;
+            break;
+        }
+    }
+
+    // single polygon tests used by both the BVH and the brute force path
+    bool SegmentHitsPoly(
+            const polyrecord_t& record,
+            const rade::float3& from,
+            const rade::float3& to,
+            rade::float3* hitPos) const;
+
+    bool RayHitsPoly(
+            const polyrecord_t& record,
+            const rade::float3& pos,
+            const rade::float3& ray,
+            rade::float3* hitPos) const;
+
+private:
+    std::vector<polyrecord_t> m_records;
+    std::vector<float> m_points;
+    std::vector<float> m_edges;
+
+    void BuildEdges(const polyrecord_t& record);
+};
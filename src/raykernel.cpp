@@ -0,0 +1,300 @@
+#include <cstring>
+#include <cmath>
+#include "raykernel.h"
+#include "rmath.h"
+
+#if RADE_RAYKERNEL_AVX2
+#include <immintrin.h>
+#elif RADE_RAYKERNEL_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+    // thin wrappers so the lane math below reads the same for every instruction set, masks are
+    // all bits set per lane for true
+#if RADE_RAYKERNEL_AVX2
+    typedef __m256 vfloat;
+
+    inline vfloat vLoad(const float* p) { return _mm256_loadu_ps(p); }
+    inline vfloat vSet(float f) { return _mm256_set1_ps(f); }
+    inline vfloat vAdd(vfloat a, vfloat b) { return _mm256_add_ps(a, b); }
+    inline vfloat vSub(vfloat a, vfloat b) { return _mm256_sub_ps(a, b); }
+    inline vfloat vMul(vfloat a, vfloat b) { return _mm256_mul_ps(a, b); }
+    inline vfloat vDiv(vfloat a, vfloat b) { return _mm256_div_ps(a, b); }
+    inline vfloat vSqrt(vfloat a) { return _mm256_sqrt_ps(a); }
+    inline vfloat vLess(vfloat a, vfloat b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+    inline vfloat vGreater(vfloat a, vfloat b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+    inline vfloat vGreaterEqual(vfloat a, vfloat b) { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+    inline vfloat vEqual(vfloat a, vfloat b) { return _mm256_cmp_ps(a, b, _CMP_EQ_OQ); }
+    inline vfloat vAnd(vfloat a, vfloat b) { return _mm256_and_ps(a, b); }
+    inline vfloat vOr(vfloat a, vfloat b) { return _mm256_or_ps(a, b); }
+    inline vfloat vXor(vfloat a, vfloat b) { return _mm256_xor_ps(a, b); }
+    inline vfloat vAbs(vfloat a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+    inline vfloat vSelect(vfloat mask, vfloat a, vfloat b) { return _mm256_blendv_ps(b, a, mask); }
+    inline uint32_t vMoveMask(vfloat mask) { return static_cast<uint32_t>(_mm256_movemask_ps(mask)); }
+    inline void vStore(float* p, vfloat a) { _mm256_storeu_ps(p, a); }
+#elif RADE_RAYKERNEL_SSE2
+    typedef __m128 vfloat;
+
+    inline vfloat vLoad(const float* p) { return _mm_loadu_ps(p); }
+    inline vfloat vSet(float f) { return _mm_set1_ps(f); }
+    inline vfloat vAdd(vfloat a, vfloat b) { return _mm_add_ps(a, b); }
+    inline vfloat vSub(vfloat a, vfloat b) { return _mm_sub_ps(a, b); }
+    inline vfloat vMul(vfloat a, vfloat b) { return _mm_mul_ps(a, b); }
+    inline vfloat vDiv(vfloat a, vfloat b) { return _mm_div_ps(a, b); }
+    inline vfloat vSqrt(vfloat a) { return _mm_sqrt_ps(a); }
+    inline vfloat vLess(vfloat a, vfloat b) { return _mm_cmplt_ps(a, b); }
+    inline vfloat vGreater(vfloat a, vfloat b) { return _mm_cmpgt_ps(a, b); }
+    inline vfloat vGreaterEqual(vfloat a, vfloat b) { return _mm_cmpge_ps(a, b); }
+    inline vfloat vEqual(vfloat a, vfloat b) { return _mm_cmpeq_ps(a, b); }
+    inline vfloat vAnd(vfloat a, vfloat b) { return _mm_and_ps(a, b); }
+    inline vfloat vOr(vfloat a, vfloat b) { return _mm_or_ps(a, b); }
+    inline vfloat vXor(vfloat a, vfloat b) { return _mm_xor_ps(a, b); }
+    inline vfloat vAbs(vfloat a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+    inline vfloat vSelect(vfloat mask, vfloat a, vfloat b) { return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b)); }
+    inline uint32_t vMoveMask(vfloat mask) { return static_cast<uint32_t>(_mm_movemask_ps(mask)); }
+    inline void vStore(float* p, vfloat a) { _mm_storeu_ps(p, a); }
+#else
+    // portable fallback, one float per lane and a bool style mask
+    typedef struct
+    {
+        float v[cRayKernelWidth];
+    } vfloat;
+
+    template<typename F>
+    inline vfloat vMap(vfloat a, vfloat b, F func)
+    {
+        vfloat r;
+        for (int i = 0; i < cRayKernelWidth; i++)
+            r.v[i] = func(a.v[i], b.v[i]);
+        return r;
+    }
+
+    inline float vMaskValue(bool b) { return b ? 1.0f : 0.0f; }
+
+    inline vfloat vLoad(const float* p) { vfloat r; memcpy(r.v, p, sizeof(r.v)); return r; }
+    inline vfloat vSet(float f) { vfloat r; for (float& v : r.v) v = f; return r; }
+    inline vfloat vAdd(vfloat a, vfloat b) { return vMap(a, b, [](float x, float y) { return x + y; }); }
+    inline vfloat vSub(vfloat a, vfloat b) { return vMap(a, b, [](float x, float y) { return x - y; }); }
+    inline vfloat vMul(vfloat a, vfloat b) { return vMap(a, b, [](float x, float y) { return x * y; }); }
+    inline vfloat vDiv(vfloat a, vfloat b) { return vMap(a, b, [](float x, float y) { return x / y; }); }
+    inline vfloat vSqrt(vfloat a) { return vMap(a, a, [](float x, float) { return sqrtf(x); }); }
+    inline vfloat vLess(vfloat a, vfloat b) { return vMap(a, b, [](float x, float y) { return vMaskValue(x < y); }); }
+    inline vfloat vGreater(vfloat a, vfloat b) { return vMap(a, b, [](float x, float y) { return vMaskValue(x > y); }); }
+    inline vfloat vGreaterEqual(vfloat a, vfloat b) { return vMap(a, b, [](float x, float y) { return vMaskValue(x >= y); }); }
+    inline vfloat vEqual(vfloat a, vfloat b) { return vMap(a, b, [](float x, float y) { return vMaskValue(x == y); }); }
+    inline vfloat vAnd(vfloat a, vfloat b) { return vMap(a, b, [](float x, float y) { return vMaskValue(x != 0.0f && y != 0.0f); }); }
+    inline vfloat vOr(vfloat a, vfloat b) { return vMap(a, b, [](float x, float y) { return vMaskValue(x != 0.0f || y != 0.0f); }); }
+    inline vfloat vXor(vfloat a, vfloat b) { return vMap(a, b, [](float x, float y) { return vMaskValue((x != 0.0f) != (y != 0.0f)); }); }
+    inline vfloat vAbs(vfloat a) { return vMap(a, a, [](float x, float) { return fabsf(x); }); }
+    inline vfloat vSelect(vfloat mask, vfloat a, vfloat b)
+    {
+        vfloat r;
+        for (int i = 0; i < cRayKernelWidth; i++)
+            r.v[i] = mask.v[i] != 0.0f ? a.v[i] : b.v[i];
+        return r;
+    }
+    inline uint32_t vMoveMask(vfloat mask)
+    {
+        uint32_t bits = 0;
+        for (int i = 0; i < cRayKernelWidth; i++)
+        {
+            if (mask.v[i] != 0.0f)
+                bits |= 1u << i;
+        }
+        return bits;
+    }
+    inline void vStore(float* p, vfloat a) { memcpy(p, a.v, sizeof(a.v)); }
+#endif
+
+    // n.p + dist, in the same order as plane3d::ClassifyPoint
+    inline vfloat PlaneDistance(vfloat nx, vfloat ny, vfloat nz, vfloat dist, const float* p)
+    {
+        vfloat d = vAdd(vMul(nx, vSet(p[0])), vMul(ny, vSet(p[1])));
+        d = vAdd(d, vMul(nz, vSet(p[2])));
+        return vAdd(d, dist);
+    }
+
+    void AddLane(
+            polyblock_t& block,
+            int lane,
+            const polyrecord_t& record,
+            const float* edges,
+            uint16_t numEdges)
+    {
+        block.nx[lane] = record.normal[0];
+        block.ny[lane] = record.normal[1];
+        block.nz[lane] = record.normal[2];
+        block.dist[lane] = record.dist;
+        block.axis[lane] = static_cast<float>(record.axis);
+        for (int e = 0; e < cRayKernelMaxEdges; e++)
+        {
+            // triangles get an edge that accepts every point
+            bool used = e < numEdges;
+            block.ea[e][lane] = used ? edges[e * 3] : 0.0f;
+            block.eb[e][lane] = used ? edges[e * 3 + 1] : 0.0f;
+            block.ec[e][lane] = used ? edges[e * 3 + 2] : 1.0f;
+        }
+    }
+}
+
+void CRayKernel::PackPolys(
+        const CPolyCache& polyCache,
+        const uint32_t* polyIndices,
+        size_t numPolys,
+        std::vector<polyblock_t>& blocks)
+{
+    int lane = cRayKernelWidth;
+    auto nextLane = [&]() -> polyblock_t&
+    {
+        if (lane == cRayKernelWidth)
+        {
+            // a zero normal never passes the facing test, so empty lanes need no mask
+            polyblock_t empty;
+            memset(&empty, 0, sizeof(empty));
+            blocks.push_back(empty);
+            lane = 0;
+        }
+        lane++;
+        return blocks.back();
+    };
+
+    for (size_t i = 0; i < numPolys; i++)
+    {
+        const polyrecord_t& record = polyCache.Get(polyIndices[i]);
+        if (record.numPoints < 3)
+            continue;
+
+        if (record.numPoints <= cRayKernelMaxEdges)
+        {
+            polyblock_t& block = nextLane();
+            AddLane(block, lane - 1, record, polyCache.GetEdges(record), record.numPoints);
+            continue;
+        }
+
+        // split into quads fanned from the first point, sharing the plane of the whole poly. The
+        // inner fan edges get the same tolerance as the outer ones so no gap opens between pieces
+        const float* points = polyCache.GetPoints(record);
+        for (uint16_t p = 1; p + 1 < record.numPoints; p += 2)
+        {
+            uint16_t pieceIndices[cRayKernelMaxEdges] = { 0, p, static_cast<uint16_t>(p + 1), static_cast<uint16_t>(p + 2) };
+            uint16_t piecePoints = (p + 2 < record.numPoints) ? 4 : 3;
+
+            float piece[cRayKernelMaxEdges * 3];
+            for (uint16_t j = 0; j < piecePoints; j++)
+                memcpy(&piece[j * 3], &points[pieceIndices[j] * 3], sizeof(float) * 3);
+
+            float edges[cRayKernelMaxEdges * 3];
+            CPolyCache::BuildEdgeEquations(record.axis, piece, piecePoints, edges);
+
+            polyblock_t& block = nextLane();
+            AddLane(block, lane - 1, record, edges, piecePoints);
+        }
+    }
+}
+
+void CRayKernel::SetupSegment(const rade::float3& from, const rade::float3& to, rayquery_t* query)
+{
+    query->origin[0] = from.x;
+    query->origin[1] = from.y;
+    query->origin[2] = from.z;
+    query->end[0] = to.x;
+    query->end[1] = to.y;
+    query->end[2] = to.z;
+
+    // normalised exactly as CPolyCache::GetRayIntersect does
+    float rx = to.x - from.x;
+    float ry = to.y - from.y;
+    float rz = to.z - from.z;
+    float length = sqrtf(rx * rx + ry * ry + rz * rz);
+    if (length > 0.0f)
+    {
+        float ilength = 1 / length;
+        rx *= ilength;
+        ry *= ilength;
+        rz *= ilength;
+    }
+    query->dir[0] = rx;
+    query->dir[1] = ry;
+    query->dir[2] = rz;
+    query->rayLength = length;
+    query->isSegment = true;
+}
+
+void CRayKernel::SetupRay(const rade::float3& pos, const rade::float3& ray, rayquery_t* query)
+{
+    query->origin[0] = pos.x;
+    query->origin[1] = pos.y;
+    query->origin[2] = pos.z;
+    query->end[0] = pos.x + ray.x;
+    query->end[1] = pos.y + ray.y;
+    query->end[2] = pos.z + ray.z;
+    query->dir[0] = ray.x;
+    query->dir[1] = ray.y;
+    query->dir[2] = ray.z;
+    query->rayLength = sqrtf(ray.x * ray.x + ray.y * ray.y + ray.z * ray.z);
+    query->isSegment = false;
+}
+
+uint32_t CRayKernel::Intersect(const polyblock_t& block, const rayquery_t& query, float* hitDistance)
+{
+    const vfloat nx = vLoad(block.nx);
+    const vfloat ny = vLoad(block.ny);
+    const vfloat nz = vLoad(block.nz);
+    const vfloat dist = vLoad(block.dist);
+    const vfloat epsilon = vSet(rade::math::cEpsilon);
+    const vfloat negEpsilon = vSet(-rade::math::cEpsilon);
+
+    vfloat startDist = PlaneDistance(nx, ny, nz, dist, query.origin);
+
+    // facing test, also rejects the empty lanes
+    vfloat dotNormRay = vAdd(vMul(nx, vSet(query.dir[0])), vMul(ny, vSet(query.dir[1])));
+    dotNormRay = vAdd(dotNormRay, vMul(nz, vSet(query.dir[2])));
+    vfloat mask = vGreater(dotNormRay, epsilon);
+
+    vfloat t = vDiv(vSub(vSet(0.0f), startDist), dotNormRay);
+    if (query.isSegment)
+    {
+        // the end points must classify differently
+        vfloat endDist = PlaneDistance(nx, ny, nz, dist, query.end);
+        vfloat back = vXor(vLess(startDist, negEpsilon), vLess(endDist, negEpsilon));
+        vfloat front = vXor(vGreater(startDist, epsilon), vGreater(endDist, epsilon));
+        mask = vAnd(mask, vOr(back, front));
+        mask = vAnd(mask, vGreater(vAbs(t), vSet(rade::math::cEpsilonLarger)));
+    }
+    else
+    {
+        mask = vAnd(mask, vGreater(t, epsilon));
+    }
+
+    if (vMoveMask(mask) == 0)
+        return 0;
+
+    vfloat hx = vAdd(vSet(query.origin[0]), vMul(vSet(query.dir[0]), t));
+    vfloat hy = vAdd(vSet(query.origin[1]), vMul(vSet(query.dir[1]), t));
+    vfloat hz = vAdd(vSet(query.origin[2]), vMul(vSet(query.dir[2]), t));
+
+    // project per lane: YZ -> (y, z), XZ -> (x, z), XY -> (x, y)
+    vfloat axis = vLoad(block.axis);
+    vfloat u = vSelect(vEqual(axis, vSet(static_cast<float>(rade::plane3d::EPlaneAxis_YZ))), hy, hx);
+    vfloat v = vSelect(vEqual(axis, vSet(static_cast<float>(rade::plane3d::EPlaneAxis_XY))), hy, hz);
+
+    const vfloat tolerance = vSet(-cPolyEdgeTolerance);
+    for (int e = 0; e < cRayKernelMaxEdges; e++)
+    {
+        vfloat edge = vAdd(vAdd(vMul(vLoad(block.ea[e]), u), vMul(vLoad(block.eb[e]), v)), vLoad(block.ec[e]));
+        mask = vAnd(mask, vGreaterEqual(edge, tolerance));
+    }
+
+    uint32_t hits = vMoveMask(mask);
+    if (hits && hitDistance)
+    {
+        // vector3::Distance of the hit point from the origin
+        vfloat dx = vSub(vSet(query.origin[0]), hx);
+        vfloat dy = vSub(vSet(query.origin[1]), hy);
+        vfloat dz = vSub(vSet(query.origin[2]), hz);
+        vStore(hitDistance, vSqrt(vAdd(vAdd(vMul(dx, dx), vMul(dy, dy)), vMul(dz, dz))));
+    }
+    return hits;
+}
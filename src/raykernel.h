@@ -0,0 +1,74 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include "point3d.h"
+#include "polycache.h"
+
+// lanes per polygon block. AVX2 builds test 8 polys per call, SSE2 (all x86-64 builds) 4, and
+// other targets run the same layout through a scalar loop
+#if defined(__AVX2__)
+#define RADE_RAYKERNEL_AVX2 1
+const int cRayKernelWidth = 8;
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define RADE_RAYKERNEL_SSE2 1
+const int cRayKernelWidth = 4;
+#else
+const int cRayKernelWidth = 4;
+#endif
+
+// edges per lane, polys with more points are split into convex fan pieces
+const int cRayKernelMaxEdges = 4;
+
+// structure of arrays block of up to cRayKernelWidth convex polys (or fan pieces of larger ones).
+// Each lane holds the poly plane, the dominant axis and the projected 2D edge equations from
+// CPolyCache, so a lane gives exactly the same answer as the scalar CPolyCache tests
+typedef struct
+{
+    float nx[cRayKernelWidth];
+    float ny[cRayKernelWidth];
+    float nz[cRayKernelWidth];
+    float dist[cRayKernelWidth];
+    float axis[cRayKernelWidth];    // rade::plane3d::EPlaneAxis as float, unused lanes have a zero normal
+    float ea[cRayKernelMaxEdges][cRayKernelWidth];
+    float eb[cRayKernelMaxEdges][cRayKernelWidth];
+    float ec[cRayKernelMaxEdges][cRayKernelWidth];
+} polyblock_t;
+
+// one segment or ray, set up once and tested against many blocks
+typedef struct
+{
+    float origin[3];
+    float end[3];       // segment end, unused for rays
+    float dir[3];       // normalised segment direction, or the ray as given
+    float rayLength;    // length of dir for rays
+    bool isSegment;
+} rayquery_t;
+
+// rays traced together through the BVH, all segments or all rays
+const uint32_t cMaxPacketRays = 64;
+
+typedef struct
+{
+    rayquery_t rays[cMaxPacketRays];
+    uint32_t numRays;
+} raypacket_t;
+
+class CRayKernel
+{
+public:
+
+    // pack the polys (indices into the cache) into blocks, appended to blocks
+    static void PackPolys(
+            const CPolyCache& polyCache,
+            const uint32_t* polyIndices,
+            size_t numPolys,
+            std::vector<polyblock_t>& blocks);
+
+    static void SetupSegment(const rade::float3& from, const rade::float3& to, rayquery_t* query);
+
+    static void SetupRay(const rade::float3& pos, const rade::float3& ray, rayquery_t* query);
+
+    // returns a bit mask of the lanes hit, hitDistance receives the distance from the origin per lane
+    static uint32_t Intersect(const polyblock_t& block, const rayquery_t& query, float* hitDistance);
+};
@@ -0,0 +1,99 @@
+#include <cmath>
+#include "sphereraycache.h"
+#include "rmath.h"
+#include "osutils.h"
+
+void CSphereRayCache::Reset(size_t expectedNormals)
+{
+    Clear();
+
+    // power of two of at least twice the expected count keeps probe runs short
+    size_t numSlots = 16;
+    while (numSlots < expectedNormals * 2)
+        numSlots *= 2;
+
+    m_slots.reset(new std::atomic<sphererays_t*>[numSlots]);
+    for (size_t i = 0; i < numSlots; i++)
+        m_slots[i] = nullptr;
+    m_numSlots = numSlots;
+}
+
+void CSphereRayCache::Clear()
+{
+    m_slots.reset();
+    m_numSlots = 0;
+    m_sets.clear();
+}
+
+void CSphereRayCache::Quantize(const rade::float3& normal, int32_t* key)
+{
+    // normals closer than the epsilon vector3::operator== uses share a set
+    const float components[3] = { normal.x, normal.y, normal.z };
+    for (int i = 0; i < 3; i++)
+        key[i] = static_cast<int32_t>(std::lround(components[i] / rade::math::cEpsilon));
+}
+
+size_t CSphereRayCache::Hash(const int32_t* key)
+{
+    uint32_t h = 2166136261u;
+    for (int i = 0; i < 3; i++)
+    {
+        h ^= static_cast<uint32_t>(key[i]);
+        h *= 16777619u;
+    }
+    return h;
+}
+
+const sphererays_t* CSphereRayCache::Own(std::unique_ptr<sphererays_t> set)
+{
+    std::lock_guard<std::mutex> lock(m_writeMutex);
+    m_sets.push_back(std::move(set));
+    return m_sets.back().get();
+}
+
+const sphererays_t* CSphereRayCache::Get(const rade::float3& normal, const generator_t& generator)
+{
+    int32_t key[3];
+    Quantize(normal, key);
+
+    std::unique_ptr<sphererays_t> created;
+    auto create = [&]()
+    {
+        created.reset(new sphererays_t);
+        for (int i = 0; i < 3; i++)
+            created->key[i] = key[i];
+        created->normal = rade::float3(key[0] * rade::math::cEpsilon, key[1] * rade::math::cEpsilon, key[2] * rade::math::cEpsilon);
+        created->normal.Normalize();
+        generator(created->normal, created->key, created->rays);
+    };
+
+    size_t mask = m_numSlots - 1;
+    size_t slot = Hash(key) & mask;
+
+    for (size_t probe = 0; probe < m_numSlots; probe++, slot = (slot + 1) & mask)
+    {
+        sphererays_t* entry = m_slots[slot].load(std::memory_order_acquire);
+        if (!entry)
+        {
+            // miss, generate outside any lock then race to publish it in this slot
+            if (!created)
+                create();
+
+            if (m_slots[slot].compare_exchange_strong(entry, created.get(),
+                    std::memory_order_acq_rel, std::memory_order_acquire))
+            {
+                return Own(std::move(created));
+            }
+            // another thread filled the slot first, entry now holds its set
+        }
+
+        if (entry->key[0] == key[0] && entry->key[1] == key[1] && entry->key[2] == key[2])
+            return entry;
+    }
+
+    // table full (more normals than Reset() was told about), hand out an uncached set
+    rade::Log("CSphereRayCache is full, resize with more normals\n");
+    if (!created)
+        create();
+    return Own(std::move(created));
+}
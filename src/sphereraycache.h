@@ -0,0 +1,52 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "float3.h"
+
+// the AO ray set generated for one surface normal
+typedef struct
+{
+    int32_t key[3];     // quantised normal
+    rade::float3 normal;    // centre of the key's cell
+    std::vector<rade::float3> rays;
+} sphererays_t;
+
+// concurrent cache of AO ray sets keyed on the quantised normal. Lookups are a lock-free probe of
+// an open addressing table, a miss generates the set and publishes it with a compare and swap.
+// Entries are never removed until Clear(), so returned pointers stay valid for the whole bake
+class CSphereRayCache
+{
+public:
+
+    // called with the normal at the centre of the quantisation cell and the cell key, so the set
+    // does not depend on which thread inserts it first
+    typedef std::function<void(const rade::float3& normal, const int32_t* key, std::vector<rade::float3>& rays)> generator_t;
+
+    // size the table for about expectedNormals distinct normals, not thread safe
+    void Reset(size_t expectedNormals);
+
+    void Clear();
+
+    // the ray set for normal, generated on first use. Safe to call from any number of threads
+    const sphererays_t* Get(const rade::float3& normal, const generator_t& generator);
+
+private:
+
+    std::unique_ptr<std::atomic<sphererays_t*>[]> m_slots;
+    size_t m_numSlots = 0;
+
+    // owns every published set, only locked when a new set is inserted
+    std::vector<std::unique_ptr<sphererays_t>> m_sets;
+    std::mutex m_writeMutex;
+
+    static void Quantize(const rade::float3& normal, int32_t* key);
+
+    static size_t Hash(const int32_t* key);
+
+    const sphererays_t* Own(std::unique_ptr<sphererays_t> set);
+};
@@ -0,0 +1,83 @@
+// masked blurs renormalise the weights of every lumel near the mask edge, a flat area has to
+// come out of them unchanged at every radius, for both kernels and every byte value
+
+#include <cstdio>
+#include <vector>
+#include "blur.h"
+
+namespace
+{
+    const int cWidth = 40;
+    const int cHeight = 32;
+
+    int g_failures = 0;
+
+    // the lumels of a poly with a sloped edge, so taps get cut off at every distance from it
+    std::vector<uint8_t> MakeMask()
+    {
+        std::vector<uint8_t> mask(cWidth * cHeight, 0);
+        for (int y = 2; y < cHeight - 3; y++)
+        {
+            for (int x = 3; x < cWidth - 2; x++)
+            {
+                if (x * 2 >= y + 3)
+                    mask[y * cWidth + x] = 1;
+            }
+        }
+        return mask;
+    }
+
+    void TestFlat(const char* name, int channels, rade::blur::EKernel kernel, const std::vector<uint8_t>& mask)
+    {
+        size_t size = static_cast<size_t>(cWidth) * cHeight * channels;
+        std::vector<unsigned char> pixels(size);
+        std::vector<unsigned char> scratch(size);
+        for (int radius = 1; radius <= rade::blur::cMaxRadius; radius++)
+        {
+            for (int value = 0; value < 256; value++)
+            {
+                // a different flat value per channel
+                for (size_t i = 0; i < size; i++)
+                {
+                    int c = static_cast<int>(i % channels);
+                    pixels[i] = static_cast<unsigned char>(c == 1 ? 255 - value : (value + c * 85) & 255);
+                }
+
+                if (channels == 4)
+                    rade::blur::BlurRGBA(pixels.data(), scratch.data(), cWidth, cHeight, kernel, radius, mask.data());
+                else
+                    rade::blur::BlurRGB(pixels.data(), scratch.data(), cWidth, cHeight, kernel, radius, mask.data());
+
+                for (size_t i = 0; i < size; i++)
+                {
+                    int c = static_cast<int>(i % channels);
+                    int expected = c == 1 ? 255 - value : (value + c * 85) & 255;
+                    if (pixels[i] != expected)
+                    {
+                        printf("FAIL %s radius %d: lumel %zu channel %d is %d, expected %d\n", name, radius,
+                                i / channels, c, pixels[i], expected);
+                        g_failures++;
+                        break;
+                    }
+                }
+            }
+        }
+    }
+}
+
+int main()
+{
+    std::vector<uint8_t> mask = MakeMask();
+    TestFlat("masked gaussian RGBA", 4, rade::blur::EKernel_Gaussian, mask);
+    TestFlat("masked gaussian RGB", 3, rade::blur::EKernel_Gaussian, mask);
+    TestFlat("masked box RGBA", 4, rade::blur::EKernel_Box, mask);
+    TestFlat("masked box RGB", 3, rade::blur::EKernel_Box, mask);
+
+    if (g_failures)
+    {
+        printf("%d failures\n", g_failures);
+        return 1;
+    }
+    printf("blur: flat masked images are unchanged at every radius\n");
+    return 0;
+}
@@ -0,0 +1,163 @@
+// CMeshGL::BuildBuffers on a large quad grid: every face must come back exactly out of the
+// index buffer with its bucket's state, and the draw ranges must tile the buffer without
+// going over the range limit
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include "mesh_gl.h"
+
+using namespace NRenderTypes;
+
+namespace
+{
+    const uint32_t cGridSize = 1300;
+
+    int g_failures = 0;
+
+    void Fail(const char* test, const char* what, size_t index)
+    {
+        // a broken build fails millions of checks, the first few are enough
+        if (g_failures++ < 20)
+            printf("FAIL %s: %s (%zu)\n", test, what, index);
+    }
+
+    Vert MakeVert(uint32_t x, uint32_t z)
+    {
+        Vert v {};
+        v.position = { static_cast<float>(x), static_cast<float>((x + z) % 7), static_cast<float>(z) };
+        v.normal = { 0.0f, 1.0f, 0.0f };
+        v.texCoord = { x * 0.25f, z * 0.25f };
+        v.texCoordLM = { (x % 100) / 100.0f, (z % 100) / 100.0f };
+        return v;
+    }
+
+    // two triangles per cell, fanned from the first corner as the mesh fans its polys. The
+    // buckets cut across each other so the faces of one arrive interleaved with the others
+    void BuildGrid(std::vector<Tri>& faces)
+    {
+        faces.reserve(cGridSize * cGridSize * 2);
+        for (uint32_t z = 0; z < cGridSize; z++)
+        {
+            for (uint32_t x = 0; x < cGridSize; x++)
+            {
+                Tri tri {};
+                tri.materialID = (x / 64 + z / 64) % 3;
+                tri.shaderID = (z / 400) % 2;
+                tri.lightmapID = x / 100 + (z / 100) * 13;
+
+                Vert corners[4] = { MakeVert(x, z), MakeVert(x + 1, z), MakeVert(x + 1, z + 1), MakeVert(x, z + 1) };
+                tri.verts[0] = corners[0];
+                tri.verts[1] = corners[1];
+                tri.verts[2] = corners[2];
+                faces.push_back(tri);
+                tri.verts[1] = corners[2];
+                tri.verts[2] = corners[3];
+                faces.push_back(tri);
+            }
+        }
+    }
+
+    // the grid face a triangle was built from, from its cell and which side of the diagonal
+    // its centre is on
+    size_t FindFace(const Vert* verts)
+    {
+        float minX = verts[0].position.x;
+        float minZ = verts[0].position.z;
+        float sumX = 0.0f;
+        float sumZ = 0.0f;
+        for (int i = 0; i < 3; i++)
+        {
+            minX = std::min(minX, verts[i].position.x);
+            minZ = std::min(minZ, verts[i].position.z);
+            sumX += verts[i].position.x;
+            sumZ += verts[i].position.z;
+        }
+        auto x = static_cast<size_t>(minX);
+        auto z = static_cast<size_t>(minZ);
+        size_t half = (sumX / 3.0f - minX) > (sumZ / 3.0f - minZ) ? 0 : 1;
+        return (z * cGridSize + x) * 2 + half;
+    }
+
+    void TestBuildBuffers(const char* test, const std::vector<Tri>& faces, uint32_t maxRangeIndices)
+    {
+        std::vector<Vert> verts;
+        std::vector<uint32_t> indices;
+        std::vector<CMeshGL::drawRange_t> ranges;
+        CMeshGL::BuildBuffers(faces, maxRangeIndices, verts, indices, ranges);
+
+        if (indices.size() != faces.size() * 3)
+            Fail(test, "index count is not three per face", indices.size());
+        for (size_t i = 0; i < indices.size(); i++)
+        {
+            if (indices[i] >= verts.size())
+                Fail(test, "index past the end of the vertices", i);
+        }
+
+        // the ranges run back to back from the start of the buffer to the end
+        uint32_t nextIndex = 0;
+        for (size_t r = 0; r < ranges.size(); r++)
+        {
+            const CMeshGL::drawRange_t& range = ranges[r];
+            if (range.firstIndex != nextIndex)
+                Fail(test, "range does not start where the last one ended", r);
+            if (range.numIndices == 0 || range.numIndices % 3 != 0)
+                Fail(test, "range is empty or not whole triangles", r);
+            if (range.numIndices > maxRangeIndices)
+                Fail(test, "range is over the limit", r);
+            nextIndex = range.firstIndex + range.numIndices;
+        }
+        if (nextIndex != indices.size())
+            Fail(test, "ranges do not cover the index buffer", nextIndex);
+
+        // every face once, with the vertices and state it went in with
+        std::vector<uint8_t> seen(faces.size(), 0);
+        for (size_t r = 0; r < ranges.size(); r++)
+        {
+            const CMeshGL::drawRange_t& range = ranges[r];
+            for (uint32_t i = range.firstIndex; i < range.firstIndex + range.numIndices && i + 2 < indices.size(); i += 3)
+            {
+                Vert triVerts[3] = { verts[indices[i]], verts[indices[i + 1]], verts[indices[i + 2]] };
+                size_t face = FindFace(triVerts);
+                if (face >= faces.size())
+                {
+                    Fail(test, "triangle is not on the grid", i);
+                    continue;
+                }
+                if (seen[face]++)
+                    Fail(test, "face drawn twice", face);
+                if (memcmp(triVerts, faces[face].verts, sizeof(triVerts)) != 0)
+                    Fail(test, "face vertices changed", face);
+                if (range.materialID != faces[face].materialID || range.shaderID != faces[face].shaderID ||
+                        range.lightmapID != faces[face].lightmapID)
+                    Fail(test, "face drawn with another bucket's state", face);
+            }
+        }
+        for (size_t face = 0; face < faces.size(); face++)
+        {
+            if (!seen[face])
+                Fail(test, "face missing", face);
+        }
+
+        printf("%s: %zu faces, %zu verts, %zu ranges\n", test, faces.size(), verts.size(), ranges.size());
+    }
+}
+
+int main()
+{
+    std::vector<Tri> faces;
+    BuildGrid(faces);
+
+    TestBuildBuffers("mesh range limit", faces, CMeshGL::cMaxRangeIndices);
+    // not a multiple of 3, the ranges round it down to whole triangles
+    TestBuildBuffers("tiny range limit", faces, 10);
+
+    if (g_failures)
+    {
+        printf("%d failures\n", g_failures);
+        return 1;
+    }
+    printf("meshbuffers: all checks passed\n");
+    return 0;
+}
@@ -0,0 +1,120 @@
+// CPolyCache::PointInPoly (projected edge functions) against poly3d::PointInPoly (angle sum)
+// on the lumels that matter for shadow leaks: on and next to edges and vertices
+
+#include <cstdio>
+#include <cmath>
+#include <vector>
+#include "polycache.h"
+#include "polygon3d.h"
+
+namespace
+{
+    int g_failures = 0;
+
+    void Check(bool condition, const char* polyName, const char* what, const rade::vector3& p)
+    {
+        if (condition)
+            return;
+        printf("FAIL %s: %s at (%f, %f, %f)\n", polyName, what, p.x, p.y, p.z);
+        g_failures++;
+    }
+
+    rade::vector3 Lerp(const rade::vector3& a, const rade::vector3& b, float t)
+    {
+        return rade::vector3(a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t, a.z + (b.z - a.z) * t);
+    }
+
+    // p moved distance along the in-plane direction away from the centre
+    rade::vector3 PushOut(const rade::vector3& p, const rade::vector3& center, float distance)
+    {
+        rade::vector3 dir = p - center;
+        dir.Normalize();
+        return rade::vector3(p.x + dir.x * distance, p.y + dir.y * distance, p.z + dir.z * distance);
+    }
+
+    rade::poly3d MakePoly(const std::vector<rade::vector3>& points)
+    {
+        rade::poly3d poly;
+        for (const rade::vector3& p : points)
+            poly.AddPoint(p);
+        poly.CalcNormal();
+        return poly;
+    }
+
+    void TestPoly(const char* name, const rade::poly3d& poly)
+    {
+        std::vector<rade::poly3d> polyList(1, poly);
+        CPolyCache cache;
+        cache.Build(polyList);
+        const polyrecord_t& record = cache.Get(0);
+
+        auto cacheInside = [&](const rade::vector3& p)
+        {
+            return cache.PointInPoly(record, rade::float3(p.x, p.y, p.z));
+        };
+
+        rade::vector3 center = poly.GetCenter();
+        Check(cacheInside(center) && poly.PointInPoly(center) == 1, name, "centre not inside", center);
+
+        size_t numPoints = poly.NumPoints();
+        for (size_t i = 0; i < numPoints; i++)
+        {
+            rade::vector3 a = poly.GetPoint(i);
+            rade::vector3 b = poly.GetPoint((i + 1) % numPoints);
+
+            for (float t : { 0.25f, 0.5f, 0.75f })
+            {
+                // lumels exactly on the edge are inside. The angle sum is a coin toss here
+                // (one angle is pi, acosf rounding decides), so it is not compared
+                rade::vector3 p = Lerp(a, b, t);
+                Check(cacheInside(p), name, "edge lumel rejected", p);
+
+                // just inside the edge both tests take them
+                rade::vector3 in = Lerp(p, center, 0.01f);
+                Check(cacheInside(in), name, "lumel by an edge rejected", in);
+                Check(cacheInside(in) == (poly.PointInPoly(in) == 1), name, "lumel by an edge disagrees", in);
+            }
+
+            // lumels just inside a vertex, the angle sum is undefined exactly on one
+            rade::vector3 nearVertex = Lerp(a, center, 0.01f);
+            Check(cacheInside(nearVertex), name, "lumel by a vertex rejected", nearVertex);
+            Check(cacheInside(nearVertex) == (poly.PointInPoly(nearVertex) == 1), name,
+                    "lumel by a vertex disagrees", nearVertex);
+
+            // exactly on the vertex the edge functions are zero, so it is inside
+            Check(cacheInside(a), name, "vertex lumel rejected", a);
+
+            // well outside, both tests reject
+            rade::vector3 farOut = PushOut(Lerp(a, b, 0.5f), center, 1.0f);
+            Check(!cacheInside(farOut), name, "outside lumel accepted", farOut);
+            Check(cacheInside(farOut) == (poly.PointInPoly(farOut) == 1), name, "outside lumel disagrees", farOut);
+
+            // past the edge by more than the tolerance is outside. The angle sum lets these
+            // through (the shadow leaks), so only the cache is checked
+            rade::vector3 justOut = PushOut(Lerp(a, b, 0.5f), center, cPolyEdgeTolerance * 10.0f);
+            Check(!cacheInside(justOut), name, "lumel past the edge tolerance accepted", justOut);
+
+            rade::vector3 withinTolerance = PushOut(Lerp(a, b, 0.5f), center, cPolyEdgeTolerance * 0.5f);
+            Check(cacheInside(withinTolerance), name, "lumel within the edge tolerance rejected", withinTolerance);
+        }
+    }
+}
+
+int main()
+{
+    // floor, ceiling (opposite winding), walls on the other two axes and a sloped pentagon
+    TestPoly("floor quad", MakePoly({ { 0, 0, 0 }, { 0, 0, 8 }, { 8, 0, 8 }, { 8, 0, 0 } }));
+    TestPoly("ceiling quad", MakePoly({ { 0, 4, 0 }, { 8, 4, 0 }, { 8, 4, 8 }, { 0, 4, 8 } }));
+    TestPoly("x wall triangle", MakePoly({ { 2, 0, 0 }, { 2, 6, 1 }, { 2, 1, 5 } }));
+    TestPoly("z wall quad", MakePoly({ { 0, 0, 3 }, { 4, 0, 3 }, { 4, 3, 3 }, { 0, 3, 3 } }));
+    TestPoly("sloped pentagon", MakePoly({
+            { 0, 0, 0 }, { 4, 1, 0 }, { 5, 2, 3 }, { 2, 2.5f, 5 }, { -1, 1, 3 } }));
+
+    if (g_failures)
+    {
+        printf("%d failures\n", g_failures);
+        return 1;
+    }
+    printf("polycache: all point in poly checks passed\n");
+    return 0;
+}
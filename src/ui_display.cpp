@@ -4,6 +4,7 @@
 #include "imgui.h"
 #include "appmain.h"
 #include "osutils.h"
+#include "blur.h"
 
 CUIDisplay::CUIDisplay(CAppMain& appMain) :
         m_appMain(appMain)
@@ -39,7 +40,11 @@ void CUIDisplay::DrawLightmapGeneratorPanel()
     ImGui::Checkbox("Ambient Occlusion", &m_lampOptions.createAO);
     ImGui::Checkbox("Shadows", &m_lampOptions.createShadows);
     ImGui::Checkbox("Sun", &m_lampOptions.createSun);
+    ImGui::Checkbox("HDR (RGBM)", &m_lampOptions.hdr);
     ImGui::SliderInt("Post Blur", &m_lampOptions.postBlur, 0, 4);
+    ImGui::SliderInt("Blur Radius", &m_lampOptions.blurRadius, 1, rade::blur::cMaxRadius);
+    ImGui::Combo("Blur Kernel", &m_lampOptions.blurKernel, "Box\0Gaussian\0");
+    ImGui::Checkbox("Blur inside poly only", &m_lampOptions.blurMask);
     ImGui::SliderFloat("Texture Size", &m_lampOptions.lmDetail, 0.6f, 1.8f);
     ImGui::DragFloat3("Sun Direction", m_lampOptions.sunDir);
     ImGui::ColorEdit3("Sun Colour", m_lampOptions.sunColour);
@@ -48,6 +53,8 @@ void CUIDisplay::DrawLightmapGeneratorPanel()
     ImGui::Text("AO Settings");
     ImGui::SliderInt("Sphere Rays", &m_lampOptions.numSphereRays, 20, 80);
     ImGui::SliderFloat("Sphere Size", &m_lampOptions.sphereSize, 5, 100);
+    ImGui::Combo("Sampling", &m_lampOptions.samplingMode, "Random\0Stratified\0Hammersley\0");
+    ImGui::InputInt("Seed", &m_lampOptions.seed);
     ImGui::Separator();
 
     ImGui::Text("Shadow Settings");
@@ -55,6 +62,13 @@ void CUIDisplay::DrawLightmapGeneratorPanel()
     ImGui::SliderInt("Unlit intensity", &m_lampOptions.shadowUnlit, 0, 127);
     ImGui::Separator();
 
+    ImGui::Text("Performance");
+    ImGui::Checkbox("Use BVH", &m_lampOptions.useBVH);
+    ImGui::Checkbox("Ray packets", &m_lampOptions.usePackets);
+    ImGui::SliderInt("Threads (0 = auto)", &m_lampOptions.numThreads, 0, 64);
+    ImGui::SliderInt("Atlas size (0 = off)", &m_lampOptions.atlasSize, 0, 4096);
+    ImGui::Separator();
+
     if (ImGui::Button("Generate"))
     {
         std::thread( [this] { this->GenerateLightmaps(); } ).detach();
@@ -38,7 +38,18 @@ private:
             1,      // blur
             true,   // genereate sun
             { 0.2f, 0.2f, 0.6f },  // sun colour
-            { 0.1f, 0.6f, 0.3f }   // sun dir
+            { 0.1f, 0.6f, 0.3f },  // sun dir
+            true,   // use BVH
+            true,   // ray packets
+            0,      // threads (0 = auto)
+            0,      // seed
+            2,      // AO sampling (hammersley)
+            1024,   // atlas page size, 0 = one texture per poly
+            false,  // HDR (RGBM) lightmaps
+            1,      // blur radius
+            1,      // blur kernel (gaussian)
+            false,  // blur mask
+            false   // packet benchmark
     };
 
     CLightmapGen::lmoptions_t m_lampOptions = {
@@ -52,7 +63,18 @@ private:
             1,      // blur
             true,   // genereate sun
             { 0.2f, 0.2f, 0.6f },  // sun colour
-            { 0.1f, 0.6f, 0.3f }   // sun dir
+            { 0.1f, 0.6f, 0.3f },  // sun dir
+            true,   // use BVH
+            true,   // ray packets
+            0,      // threads (0 = auto)
+            0,      // seed
+            2,      // AO sampling (hammersley)
+            1024,   // atlas page size, 0 = one texture per poly
+            false,  // HDR (RGBM) lightmaps
+            1,      // blur radius
+            1,      // blur kernel (gaussian)
+            false,  // blur mask
+            false   // packet benchmark
     };
 
     void DrawMenuBar();